@@ -0,0 +1,211 @@
+/**
+ * @brief Curvilinear Interpolable Look-up Table. It works like InterpolableLUT, but every row
+ *      in the y-direction has its own x-reference breakpoints instead of one shared list.
+ *
+ * @details In calibration data the points measured along x often differ from one y row to the
+ *      next, e.g. a buffer that was only measured at some temperatures. Padding every row out
+ *      to a shared x-reference list wastes memory and needs invented values, so the rows are
+ *      stored as they were measured, back to back in one array (compressed sparse row layout):
+ *      row r occupies [row_offsets[r], row_offsets[r+1]) of x_ref and table.
+ *
+ *      find() has the same inverse semantics as InterpolableLUT::find(). The two rows around
+ *      y_input are evaluated at the union of their breakpoints, blended in the y-direction, and
+ *      x_input is located in that blended row to interpolate the x-reference value. When every
+ *      row has the same breakpoints this gives exactly the InterpolableLUT result.
+ *
+ * @author Athly
+*/
+
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+
+class CurvilinearLUT {
+
+    public:
+        /**
+         * @param x_refs Interpolation reference values of each row, ascending within each row
+         * @param table Table values of each row, one per reference value of that row
+         * @param y_ref Interpolation reference values for the y-direction, one per row, ascending
+        */
+        CurvilinearLUT(const std::vector<std::vector<double>> &x_refs,
+                       const std::vector<std::vector<double>> &table,
+                       const std::vector<double> &y_ref):y_ref(y_ref) {
+            if (x_refs.size() != y_ref.size() || table.size() != y_ref.size()) {
+                throw std::invalid_argument("Need one x-reference list and one table row per y-reference value");
+            }
+            for (size_t i = 1; i < y_ref.size(); i++) {
+                if (!(y_ref[i - 1] < y_ref[i])) {
+                    throw std::invalid_argument("y-reference values must be ascending");
+                }
+            }
+
+            row_offsets.push_back(0);
+            for (size_t row = 0; row < y_ref.size(); row++) {
+                if (x_refs[row].size() != table[row].size()) {
+                    throw std::invalid_argument("Row x-reference and table lengths differ");
+                }
+                for (size_t i = 1; i < x_refs[row].size(); i++) {
+                    if (!(x_refs[row][i - 1] < x_refs[row][i])) {
+                        throw std::invalid_argument("Row x-reference values must be ascending");
+                    }
+                }
+                x_ref.insert(x_ref.end(), x_refs[row].begin(), x_refs[row].end());
+                this->table.insert(this->table.end(), table[row].begin(), table[row].end());
+                row_offsets.push_back(x_ref.size());
+            }
+        }
+
+        ~CurvilinearLUT() { }
+
+        /**
+         * @brief Calculates the standardized (based on the reference lists) value for x_input
+         * @return The standardized value, or x_input if it is out of range of the table
+        */
+        double find(double x_input, double y_input) const {
+            int y_lower_idx = 0;
+            if (!find_row(y_input, &y_lower_idx)) {
+                return x_input;
+            }
+            double t = (y_input - y_ref[y_lower_idx]) / (y_ref[y_lower_idx + 1] - y_ref[y_lower_idx]);
+
+            const double *xa = &x_ref[row_offsets[y_lower_idx]];
+            const double *va = &table[row_offsets[y_lower_idx]];
+            size_t len_a = row_offsets[y_lower_idx + 1] - row_offsets[y_lower_idx];
+            const double *xb = &x_ref[row_offsets[y_lower_idx + 1]];
+            const double *vb = &table[row_offsets[y_lower_idx + 1]];
+            size_t len_b = row_offsets[y_lower_idx + 2] - row_offsets[y_lower_idx + 1];
+            if (len_a < 2 || len_b < 2) {
+                return x_input;
+            }
+
+            // Walk the union of both rows' breakpoints over the x range they share. Each step
+            // gives one point of the blended row, which is checked against the previous one.
+            double start = std::max(xa[0], xb[0]);
+            double end = std::min(xa[len_a - 1], xb[len_b - 1]);
+            size_t ia = 0;
+            size_t ib = 0;
+            bool have_previous = false;
+            double previous_x = 0;
+            double previous_value = 0;
+            double u = start;
+            while (u <= end) {
+                while (ia + 2 < len_a && xa[ia + 1] <= u) {
+                    ia++;
+                }
+                while (ib + 2 < len_b && xb[ib + 1] <= u) {
+                    ib++;
+                }
+                double value_a = linear_interpolate(xa[ia], va[ia], xa[ia + 1], va[ia + 1], u);
+                double value_b = linear_interpolate(xb[ib], vb[ib], xb[ib + 1], vb[ib + 1], u);
+                double value = value_a + (value_b - value_a) * t;
+
+                if (have_previous &&
+                    (((previous_value <= x_input) && (value > x_input)) ||
+                     ((previous_value > x_input) && (value <= x_input)))) {
+                    return linear_interpolate(previous_value, previous_x, value, u, x_input);
+                }
+                have_previous = true;
+                previous_x = u;
+                previous_value = value;
+
+                // Next breakpoint of either row
+                if (u >= end) {
+                    break;
+                }
+                double next_a = (xa[ia + 1] > u) ? xa[ia + 1] : end;
+                double next_b = (xb[ib + 1] > u) ? xb[ib + 1] : end;
+                u = std::min(std::min(next_a, next_b), end);
+            }
+            return x_input;
+        }
+
+        /**
+         * @brief Number of rows and of measured points
+        */
+        size_t row_count() const { return y_ref.size(); }
+        size_t point_count() const { return x_ref.size(); }
+
+        /**
+         * @brief Provides read-only access to the x-reference values and table values of a row
+        */
+        std::vector<double> getXRef(size_t row) const {
+            check_row(row);
+            return std::vector<double>(x_ref.begin() + row_offsets[row], x_ref.begin() + row_offsets[row + 1]);
+        }
+
+        std::vector<double> operator[](size_t row) const {
+            check_row(row);
+            return std::vector<double>(table.begin() + row_offsets[row], table.begin() + row_offsets[row + 1]);
+        }
+
+        /**
+         * @brief Bytes used by the table, reference lists and row offsets
+        */
+        size_t memory_usage() const {
+            return (x_ref.size() + table.size() + y_ref.size()) * sizeof(double) + row_offsets.size() * sizeof(size_t);
+        }
+
+    private:
+        std::vector<double> y_ref;          ///< Interpolation reference values for the y-direction
+        std::vector<size_t> row_offsets;    ///< Start of each row in x_ref and table, plus an end marker
+        std::vector<double> x_ref;          ///< Interpolation reference values of every row, back to back
+        std::vector<double> table;          ///< Table values of every row, back to back
+
+        void check_row(size_t row) const {
+            if (row >= y_ref.size()) {
+                throw std::out_of_range("Row index out of range");
+            }
+        }
+
+        /**
+         * @brief Finds the row below y_input, using the same [lower, upper) convention as InterpolableLUT
+        */
+        bool find_row(double y_input, int *lower_result) const {
+            auto upper = std::upper_bound(y_ref.begin(), y_ref.end(), y_input);
+            if (upper == y_ref.begin() || upper == y_ref.end()) {
+                return false;
+            }
+            *lower_result = (int)(upper - y_ref.begin()) - 1;
+            return true;
+        }
+
+        // This function performs linear interpolation between two points.
+        static double linear_interpolate(double x0, double y0, double x1, double y1, double x) {
+            return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+        }
+};
+
+/******************************************************************************
+                Example for the CurvilinearLUT class
+*******************************************************************************/
+void example_curvilinear() {
+    const std::vector<double> temp_points = {0, 10, 25, 40, 55};
+
+    // Not every buffer was measured at every temperature
+    const std::vector<std::vector<double>> ph_values_at_25 = {
+        {1.68, 4.01, 6.86, 9.18, 12.46},        // 0°C
+        {4.01, 6.86, 7.00, 9.18, 10.01},        // 10°C
+        {1.68, 4.01, 6.86, 7.00, 9.18, 10.01, 12.46}, // 25°C
+        {1.68, 6.86, 9.18, 12.46},              // 40°C
+        {1.68, 4.01, 7.00, 10.01, 12.46}        // 55°C
+    };
+    const std::vector<std::vector<double>> ph_values = {
+        {1.67, 4.01, 6.98, 9.46, 13.47},
+        {4.00, 6.92, 7.06, 9.32, 10.18},
+        {1.68, 4.01, 6.86, 7.00, 9.18, 10.01, 12.46},
+        {1.70, 6.84, 9.07, 11.99},
+        {1.72, 4.08, 6.97, 9.81, 11.61}
+    };
+
+    CurvilinearLUT lutPh(ph_values_at_25, ph_values, temp_points);
+
+    printf("pH: %.2f\n", lutPh.find(7.01, 37.0));
+    printf("pH: %.2f\n", lutPh.find(8.00, 37.0));
+    printf("pH: %.2f\n", lutPh.find(9.00, 37.0));
+    printf("pH: %.2f\n", lutPh.find(4.00, 5.0));
+    printf("%zu points in %zu bytes\n", lutPh.point_count(), lutPh.memory_usage());
+}
@@ -1,18 +1,23 @@
 /**
- * @brief Interpolable Look-up Table. It provides the ability to store a look-up table 
+ * @brief Interpolable Look-up Table. It provides the ability to store a look-up table
  *      with reference values for the x and y directions that are used for interpolation.
- * 
- * @details The purpose is to be used to perform calculations based on models that don't 
+ *
+ * @details The purpose is to be used to perform calculations based on models that don't
  *      adhere to simpler mathamatical functions. For example, compensating for temperature
- *      in pH measurements varies by temperature. The higher the temperature and pH, the more 
+ *      in pH measurements varies by temperature. The higher the temperature and pH, the more
  *      impactful temperature is on the measurement.
- * 
+ *
  *      Thus, the calculation done here 'normalizes' or 'standardizes' x_input value based
  *      on the y_input value in the find() function. In the case of pH for example, the
  *      input of x and y would be pH and temperature respectively. The output would be the
  *      pH at a standardized temperature (typically 25 degrees Celsius for pH) as represented by
  *      the x-reference list
- * 
+ *
+ *      The table and reference lists can be stored as float or double, independently of the
+ *      type the interpolation is computed in. InterpolableLUT stores and computes in double,
+ *      InterpolableLUTf stores and computes in float, and InterpolableLUTMixed stores in float
+ *      but widens every value to double as it is loaded so that only the storage is rounded.
+ *
  * @author Athly
 */
 
@@ -22,144 +27,6548 @@
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#include <stdexcept>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <list>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <new>
+#include <memory>
+#include <type_traits>
 
-class InterpolableLUT {
+#include "InterpolableLUT.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// Static probes for bpftrace / SystemTap, built in with -DLUT_ENABLE_USDT when <sys/sdt.h>
+// (systemtap-sdt-dev) is available. A probe is a single NOP until a tracer attaches to it.
+#if defined(LUT_ENABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define LUT_PROBE(name, ...) STAP_PROBEV(interpolable_lut, name, __VA_ARGS__)
+#endif
+#endif
+#ifndef LUT_PROBE
+#define LUT_PROBE(name, ...) ((void)0)
+#endif
+
+/**
+ * @brief Blends two stored rows into out[i] = lower[i] + (upper[i] - lower[i]) * t
+ * @details One overload per storage/compute pairing. The float -> double overload widens
+ *      each lane on load so the arithmetic happens entirely in double.
+*/
+inline void lut_blend_rows(const double *lower, const double *upper, double t, double *out, int len) {
+    int i = 0;
+#if defined(__AVX__)
+    const __m256d vt = _mm256_set1_pd(t);
+    for (; i + 4 <= len; i += 4) {
+        __m256d lo = _mm256_loadu_pd(lower + i);
+        __m256d hi = _mm256_loadu_pd(upper + i);
+#if defined(__FMA__)
+        _mm256_storeu_pd(out + i, _mm256_fmadd_pd(_mm256_sub_pd(hi, lo), vt, lo));
+#else
+        _mm256_storeu_pd(out + i, _mm256_add_pd(lo, _mm256_mul_pd(_mm256_sub_pd(hi, lo), vt)));
+#endif
+    }
+#endif
+    for (; i < len; i++) {
+        out[i] = lower[i] + (upper[i] - lower[i]) * t;
+    }
+}
+
+inline void lut_blend_rows(const float *lower, const float *upper, float t, float *out, int len) {
+    int i = 0;
+#if defined(__AVX__)
+    const __m256 vt = _mm256_set1_ps(t);
+    for (; i + 8 <= len; i += 8) {
+        __m256 lo = _mm256_loadu_ps(lower + i);
+        __m256 hi = _mm256_loadu_ps(upper + i);
+#if defined(__FMA__)
+        _mm256_storeu_ps(out + i, _mm256_fmadd_ps(_mm256_sub_ps(hi, lo), vt, lo));
+#else
+        _mm256_storeu_ps(out + i, _mm256_add_ps(lo, _mm256_mul_ps(_mm256_sub_ps(hi, lo), vt)));
+#endif
+    }
+#endif
+    for (; i < len; i++) {
+        out[i] = lower[i] + (upper[i] - lower[i]) * t;
+    }
+}
+
+inline void lut_blend_rows(const float *lower, const float *upper, double t, double *out, int len) {
+    int i = 0;
+#if defined(__AVX__)
+    const __m256d vt = _mm256_set1_pd(t);
+    for (; i + 4 <= len; i += 4) {
+        __m256d lo = _mm256_cvtps_pd(_mm_loadu_ps(lower + i));
+        __m256d hi = _mm256_cvtps_pd(_mm_loadu_ps(upper + i));
+#if defined(__FMA__)
+        _mm256_storeu_pd(out + i, _mm256_fmadd_pd(_mm256_sub_pd(hi, lo), vt, lo));
+#else
+        _mm256_storeu_pd(out + i, _mm256_add_pd(lo, _mm256_mul_pd(_mm256_sub_pd(hi, lo), vt)));
+#endif
+    }
+#endif
+    for (; i < len; i++) {
+        out[i] = (double)lower[i] + ((double)upper[i] - (double)lower[i]) * t;
+    }
+}
+
+/**
+ * @brief Blends a precomputed row pair into out[i] = base[i] + delta[i] * t
+ * @details Same result as lut_blend_rows() on the rows the pair was built from, since
+ *      delta[i] holds upper[i] - lower[i] already in the compute type
+*/
+inline void lut_blend_delta(const double *base, const double *delta, double t, double *out, int len) {
+    int i = 0;
+#if defined(__AVX__)
+    const __m256d vt = _mm256_set1_pd(t);
+    for (; i + 4 <= len; i += 4) {
+#if defined(__FMA__)
+        _mm256_storeu_pd(out + i, _mm256_fmadd_pd(_mm256_loadu_pd(delta + i), vt, _mm256_loadu_pd(base + i)));
+#else
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(base + i), _mm256_mul_pd(_mm256_loadu_pd(delta + i), vt)));
+#endif
+    }
+#endif
+    for (; i < len; i++) {
+        out[i] = base[i] + delta[i] * t;
+    }
+}
+
+inline void lut_blend_delta(const float *base, const float *delta, float t, float *out, int len) {
+    int i = 0;
+#if defined(__AVX__)
+    const __m256 vt = _mm256_set1_ps(t);
+    for (; i + 8 <= len; i += 8) {
+#if defined(__FMA__)
+        _mm256_storeu_ps(out + i, _mm256_fmadd_ps(_mm256_loadu_ps(delta + i), vt, _mm256_loadu_ps(base + i)));
+#else
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(base + i), _mm256_mul_ps(_mm256_loadu_ps(delta + i), vt)));
+#endif
+    }
+#endif
+    for (; i < len; i++) {
+        out[i] = base[i] + delta[i] * t;
+    }
+}
+
+#if defined(__AVX2__)
+/**
+ * @brief Loads base[idx[i]] for 4 lanes of 64-bit indexes, widened to double
+*/
+inline __m256d lut_gather4(const double *base, __m256i idx) {
+    return _mm256_i64gather_pd(base, idx, 8);
+}
+
+inline __m256d lut_gather4(const float *base, __m256i idx) {
+    return _mm256_cvtps_pd(_mm256_i64gather_ps(base, idx, 4));
+}
+#endif
+
+/**
+ * @brief Work-stealing thread pool for the parallel batch paths
+ * @details Every worker owns a deque of index ranges. A worker takes ranges from the back of
+ *      its own deque and, when that is empty, steals from the front of a randomly chosen other
+ *      worker's deque. A range larger than the grain is halved before it runs: the upper half is
+ *      pushed for others to steal and the lower half is kept. Uneven work, such as a batch
+ *      that mixes small and large tables, therefore spreads over all workers instead of
+ *      staying with whichever thread a static split gave it to.
+ *
+ *      parallel_for() may be called from any thread, including from inside a running range.
+ *      The calling thread helps with queued ranges until its own call has finished.
+*/
+class LUTExecutor {
 
     public:
-        InterpolableLUT(const std::vector<std::vector<double>> (&table), 
-                        const std::vector<double> x_ref, 
-                        const std::vector<double> y_ref,
-                        int x_len,
-                        int y_len):table(table), x_ref(x_ref), y_ref(y_ref), x_len(x_len), y_len(y_len) { }
-        
-        ~InterpolableLUT() { }
-    
+        explicit LUTExecutor(size_t worker_count = std::max(1u, std::thread::hardware_concurrency()))
+            :worker_count(std::max<size_t>(1, worker_count)), queues(new Queue[this->worker_count]) {
+            for (size_t w = 0; w < this->worker_count; w++) {
+                workers.emplace_back([this, w]() { run_worker(w); });
+            }
+        }
+
+        ~LUTExecutor() {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+        }
+
+        LUTExecutor(const LUTExecutor &) = delete;
+        LUTExecutor &operator=(const LUTExecutor &) = delete;
+
         /**
-         * @brief Calculates the standardized (based on the reference lists) value for x_input
-         * @details Uses interpolation in the y-direction to create a temporary 'row' in the
-         *      x-direction
+         * @brief Process-wide executor with one worker per hardware thread
         */
-        double find(double x_input, double y_input) {
-            int x_lower_idx = 0;
-            int x_upper_idx = 0;
-            int y_lower_idx = 0;
-            int y_upper_idx = 0;
-            double result = (double)x_input;
-            
-            if (find_nearest_indexes(y_ref, y_len, y_input, &y_lower_idx, &y_upper_idx)) {
-                // Interpolate the pH values at the measured temperature for each buffer.
-                std::vector<double> interpolated_y_values_at_x(x_len);
-                for (int i = 0; i < x_len; i++) {
-                    interpolated_y_values_at_x[i] = linear_interpolate(y_ref[y_lower_idx], table[y_lower_idx][i],
-                                                                       y_ref[y_upper_idx], table[y_upper_idx][i],
-                                                                       y_input);
-                }
-                
-                if (find_nearest_indexes(interpolated_y_values_at_x, x_len, x_input, &x_lower_idx, &x_upper_idx)) {
-                    result = linear_interpolate(interpolated_y_values_at_x[x_lower_idx], x_ref[x_lower_idx],
-                                                interpolated_y_values_at_x[x_upper_idx], x_ref[x_upper_idx],
-                                                x_input);
+        static LUTExecutor &shared() {
+            static LUTExecutor executor;
+            return executor;
+        }
+
+        /**
+         * @brief Calls fn(begin, end) over ranges that together cover [0, count), none longer than grain
+         * @details Returns when every range has run. The first exception thrown by fn is rethrown here.
+        */
+        template <typename F>
+        void parallel_for(size_t count, size_t grain, F fn) {
+            grain = std::max<size_t>(1, grain);
+            if (count <= grain) {
+                if (count > 0) {
+                    fn((size_t)0, count);
+                }
+                return;
+            }
+            Job job;
+            job.run = [](void *context, size_t begin, size_t end) { (*(F *)context)(begin, end); };
+            job.context = &fn;
+            job.grain = grain;
+            job.remaining.store(count, std::memory_order_relaxed);
+            push({ &job, 0, count });
+            while (job.remaining.load(std::memory_order_acquire) != 0) {
+                Task task;
+                if (take(task)) {
+                    execute(task);
+                } else {
+                    std::this_thread::yield();
                 }
             }
+            if (job.error) {
+                std::rethrow_exception(job.error);
+            }
+        }
 
-            return result;
+        size_t workerCount() const {
+            return worker_count;
         }
 
         /**
-         * @brief Provides read-only access to the y-reference values
+         * @brief Ranges taken from another worker's deque since the executor was created
         */
-        const std::vector<double> getYRef() const {
-            return y_ref;
+        uint64_t steals() const {
+            return steal_count.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Job {
+            void (*run)(void *context, size_t begin, size_t end);
+            void *context;
+            size_t grain;
+            std::atomic<size_t> remaining;  ///< Indexes not yet run
+            std::mutex error_mutex;
+            std::exception_ptr error;
+        };
+
+        struct Task {
+            Job *job;
+            size_t begin;
+            size_t end;
+        };
+
+        struct Queue {
+            std::mutex lock;
+            std::deque<Task> tasks;
+        };
+
+        size_t worker_count;
+        std::unique_ptr<Queue[]> queues;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> queued{0};      ///< Tasks in all deques
+        std::atomic<size_t> sleeping{0};    ///< Workers waiting on wake
+        std::atomic<uint64_t> steal_count{0};
+        std::mutex sleep_mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+
+        struct WorkerIdentity {
+            const LUTExecutor *owner;
+            int index;
+        };
+
+        static WorkerIdentity &identity() {
+            thread_local WorkerIdentity worker = { nullptr, -1 };
+            return worker;
         }
-    
+
         /**
-         * @brief Provides read-only access to the table
+         * @brief Index of the calling thread's deque, or -1 if it is not one of this executor's workers
         */
-        const std::vector<double> operator[](size_t row) const {
-            if (row >= y_len) {
-                throw std::out_of_range("Row index out of range");
+        int own_queue() const {
+            return (identity().owner == this) ? identity().index : -1;
+        }
+
+        size_t random_queue() {
+            thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ (uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return (size_t)(state % worker_count);
+        }
+
+        void push(const Task &task) {
+            int own = own_queue();
+            Queue &queue = queues[(own >= 0) ? (size_t)own : random_queue()];
+            {
+                std::lock_guard<std::mutex> lock(queue.lock);
+                queue.tasks.push_back(task);
+            }
+            queued.fetch_add(1);
+            if (sleeping.load() > 0) {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                wake.notify_one();
             }
-            return table[row];
         }
-    
-    private:
-        int x_len;  ///< Size of the table int the x-direction
-        int y_len;  ///< Size of the table int the x-direction
-        std::vector<std::vector<double>> table; ///< Storage of the look-up table
-        std::vector<double> x_ref;  ///< Interpolation reference values for the x-direction 
-        std::vector<double> y_ref;  ///< Interpolation reference values for the y-direction
-        
+
         /**
-         * @brief Find the two indexes in the list where the search_val would fall in between
-         * @return Indexes via pointers lower_result and upper_result
-         *         true if the search was successful, false if the search value is out of range of the list
+         * @brief Newest task of the own deque, else the oldest task of some other deque
         */
-        bool find_nearest_indexes(std::vector<double> list, int list_len, double search_val, int *lower_result, int *upper_result) {
-            bool ret = false;
-            for (int i = 0; i < list_len-1; i++) {
-                if ((list[i] <= search_val) && (list[i+1] > search_val)) {
-                    *lower_result = i;
-                    *upper_result = i + 1;
-                    ret = true;
-                    break;
+        bool take(Task &task) {
+            if (queued.load(std::memory_order_relaxed) == 0) {
+                return false;
+            }
+            int own = own_queue();
+            if (own >= 0) {
+                Queue &queue = queues[own];
+                std::lock_guard<std::mutex> lock(queue.lock);
+                if (!queue.tasks.empty()) {
+                    task = queue.tasks.back();
+                    queue.tasks.pop_back();
+                    queued.fetch_sub(1);
+                    return true;
                 }
             }
-            return ret;
+            size_t first = random_queue();
+            for (size_t i = 0; i < worker_count; i++) {
+                size_t victim = (first + i) % worker_count;
+                if ((int)victim == own) {
+                    continue;
+                }
+                Queue &queue = queues[victim];
+                std::lock_guard<std::mutex> lock(queue.lock);
+                if (!queue.tasks.empty()) {
+                    task = queue.tasks.front();
+                    queue.tasks.pop_front();
+                    queued.fetch_sub(1);
+                    steal_count.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
         }
-        
-        // This function performs linear interpolation between two points.
-        double linear_interpolate(double x0, double y0, double x1, double y1, double x) {
-            return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+
+        void execute(Task task) {
+            Job *job = task.job;
+            while (task.end - task.begin > job->grain) {
+                size_t middle = task.begin + (task.end - task.begin) / 2;
+                push({ job, middle, task.end });
+                task.end = middle;
+            }
+            try {
+                job->run(job->context, task.begin, task.end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(job->error_mutex);
+                if (!job->error) {
+                    job->error = std::current_exception();
+                }
+            }
+            job->remaining.fetch_sub(task.end - task.begin, std::memory_order_release);
+        }
+
+        void run_worker(size_t index) {
+            identity() = { this, (int)index };
+            while (true) {
+                Task task;
+                if (take(task)) {
+                    execute(task);
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleep_mutex);
+                if (stopping) {
+                    return;
+                }
+                sleeping.fetch_add(1);
+                wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+                sleeping.fetch_sub(1);
+            }
         }
 };
 
-std::ostream& operator<<(std::ostream& os, const InterpolableLUT &table) {
-    const std::vector<double> y_ref = table.getYRef();
-    for (int i = 0; i < y_ref.size(); i++) {
-        os << std::fixed << std::setprecision(2) << y_ref[i] << "\t";
-        for (int j = 0; j < table[i].size(); j++) {
-            os << std::fixed << std::setprecision(2) << table[i][j] << "\t";
+/**
+ * @brief Calls fn(i) for every i in [0, count) on the shared LUTExecutor
+*/
+template <typename F>
+void lut_parallel_for(size_t count, F fn) {
+    LUTExecutor::shared().parallel_for(count, 1, [&fn](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            fn(i);
         }
-        os << "\n";
+    });
+}
+
+/**
+ * @brief Which queue of a LUTPriorityExecutor a request goes to
+*/
+enum class LUTPriority {
+    High,           ///< Control-loop lookups, run before any queued background work
+    Background      ///< Bulk reprocessing
+};
+
+/**
+ * @brief Thread pool that keeps urgent lookups from waiting behind bulk batches
+ * @details Requests wait in one of two queues and every worker takes from the High queue
+ *      first. Background batches are cut into slices of at most slice_len queries, each
+ *      queued on its own, so a High request waits at most for the slices already running.
+ *      Workers reserved for High never run background slices, which takes even that wait
+ *      away at the cost of those workers idling when there is no urgent work.
+ *
+ *      Queued requests still run when the executor is destroyed, so every future completes.
+*/
+class LUTPriorityExecutor {
+
+    public:
+        LUTPriorityExecutor(size_t worker_count = std::max(1u, std::thread::hardware_concurrency()),
+                            size_t reserved_for_high = 0, size_t slice_len = 256)
+            :slice_len(std::max<size_t>(1, slice_len)) {
+            worker_count = std::max<size_t>(1, worker_count);
+            reserved_for_high = std::min(reserved_for_high, worker_count - 1);
+            for (size_t w = 0; w < worker_count; w++) {
+                bool high_only = w < reserved_for_high;
+                workers.emplace_back([this, high_only]() { run_worker(high_only); });
+            }
+        }
+
+        ~LUTPriorityExecutor() {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+        }
+
+        LUTPriorityExecutor(const LUTPriorityExecutor &) = delete;
+        LUTPriorityExecutor &operator=(const LUTPriorityExecutor &) = delete;
+
+        /**
+         * @brief Queues fn. Exceptions thrown by fn are delivered through the future.
+        */
+        std::future<void> submit(LUTPriority priority, std::function<void()> fn) {
+            std::shared_ptr<std::packaged_task<void()>> task = std::make_shared<std::packaged_task<void()>>(std::move(fn));
+            std::future<void> done = task->get_future();
+            enqueue(priority, [task]() { (*task)(); });
+            return done;
+        }
+
+        /**
+         * @brief Queues a single lookup, by default ahead of all background work
+        */
+        template <typename LUT>
+        std::future<double> find(LUT &lut, double x_input, double y_input, LUTPriority priority = LUTPriority::High) {
+            std::shared_ptr<std::promise<double>> result = std::make_shared<std::promise<double>>();
+            std::future<double> done = result->get_future();
+            enqueue(priority, [&lut, x_input, y_input, result]() {
+                try {
+                    result->set_value(lut.find(x_input, y_input));
+                } catch (...) {
+                    result->set_exception(std::current_exception());
+                }
+            });
+            return done;
+        }
+
+        /**
+         * @brief Queues lut.find_batch() over the caller's buffers, in slices of at most slice_len queries
+         * @details The buffers must stay valid until the returned future is ready
+        */
+        template <typename LUT>
+        std::future<void> findBatch(LUT &lut, const double *x_input, const double *y_input, double *out, size_t len,
+                                    LUTPriority priority = LUTPriority::Background) {
+            struct Batch {
+                std::atomic<size_t> slices_left;
+                std::promise<void> done;
+                std::mutex error_mutex;
+                std::exception_ptr error;
+            };
+            std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+            std::future<void> done = batch->done.get_future();
+            size_t slices = len / slice_len + (len % slice_len != 0);
+            if (slices == 0) {
+                batch->done.set_value();
+                return done;
+            }
+            batch->slices_left.store(slices, std::memory_order_relaxed);
+
+            std::vector<std::function<void()>> tasks;
+            tasks.reserve(slices);
+            for (size_t begin = 0, count = 0; begin < len; begin += count) {
+                count = std::min(slice_len, len - begin);
+                tasks.push_back([&lut, x_input, y_input, out, begin, count, batch]() {
+                    try {
+                        lut.find_batch(x_input + begin, y_input + begin, out + begin, count);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(batch->error_mutex);
+                        if (!batch->error) {
+                            batch->error = std::current_exception();
+                        }
+                    }
+                    if (batch->slices_left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        if (batch->error) {
+                            batch->done.set_exception(batch->error);
+                        } else {
+                            batch->done.set_value();
+                        }
+                    }
+                });
+            }
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                std::deque<std::function<void()>> &queue = (priority == LUTPriority::High) ? high : background;
+                for (std::function<void()> &task : tasks) {
+                    queue.push_back(std::move(task));
+                }
+            }
+            wake.notify_all();
+            return done;
+        }
+
+        size_t sliceLength() const {
+            return slice_len;
+        }
+
+    private:
+        size_t slice_len;
+        std::vector<std::thread> workers;
+        std::mutex queue_mutex;
+        std::condition_variable wake;
+        std::deque<std::function<void()>> high;
+        std::deque<std::function<void()>> background;
+        bool stopping = false;
+
+        void enqueue(LUTPriority priority, std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                ((priority == LUTPriority::High) ? high : background).push_back(std::move(task));
+            }
+            // Workers reserved for High may be the only ones asleep, so wake everyone for urgent work
+            if (priority == LUTPriority::High) {
+                wake.notify_all();
+            } else {
+                wake.notify_one();
+            }
+        }
+
+        void run_worker(bool high_only) {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            while (true) {
+                wake.wait(lock, [&]() { return stopping || !high.empty() || (!high_only && !background.empty()); });
+                std::function<void()> task;
+                if (!high.empty()) {
+                    task = std::move(high.front());
+                    high.pop_front();
+                } else if (!high_only && !background.empty()) {
+                    task = std::move(background.front());
+                    background.pop_front();
+                } else {
+                    return;
+                }
+                lock.unlock();
+                task();
+                lock.lock();
+            }
+        }
+};
+
+/**
+ * @brief Direction a reference list or table row is sorted in
+*/
+enum class SortOrder {
+    Ascending,      ///< list[i] <= list[i+1] for every i
+    Descending,     ///< list[i] >= list[i+1] for every i
+    Unsorted        ///< Neither, searched with a linear scan
+};
+
+/**
+ * @brief Detects the direction a list is sorted in. Constant lists count as ascending.
+*/
+template <typename T>
+SortOrder detect_sort_order(const T *list, int list_len) {
+    bool ascending = true;
+    bool descending = true;
+    for (int i = 0; i < list_len-1; i++) {
+        ascending &= (list[i] <= list[i+1]);
+        descending &= (list[i] >= list[i+1]);
     }
-    return os;
+    if (ascending) {
+        return SortOrder::Ascending;
+    }
+    return descending ? SortOrder::Descending : SortOrder::Unsorted;
 }
 
-/******************************************************************************
-                Example for the InterpolateLLUT class
-*******************************************************************************/
-#define NUM_TEMP_POINTS 12
-#define NUM_PH_POINTS 7
+/**
+ * @brief What lut_check_row() found in a list
+*/
+struct LUTRowCheck {
+    bool finite;        ///< No NaN or infinite values
+    SortOrder order;    ///< As detect_sort_order()
+};
 
-void example() {
-    const std::vector<double> temp_points= {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55};
-    const std::vector<double> ph_values_at_25= {1.68, 4.01, 6.86, 7.00, 9.18, 10.01, 12.46};
+/**
+ * @brief Finiteness and detect_sort_order() of a list in one pass
+ * @details The comparisons are accumulated in registers without branching, so a check runs
+ *      at the speed the list streams from memory. A NaN makes the list both non-finite and
+ *      Unsorted.
+*/
+inline LUTRowCheck lut_check_row(const double *list, int list_len) {
+    int i = 0;
+    bool finite = true;
+    bool ascending = true;
+    bool descending = true;
+#if defined(__AVX__)
+    const __m256d magnitude = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFll));
+    const __m256d infinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d all_finite = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    __m256d all_ascending = all_finite;
+    __m256d all_descending = all_finite;
+    for (; i + 5 <= list_len; i += 4) {
+        __m256d value = _mm256_loadu_pd(list + i);
+        __m256d next = _mm256_loadu_pd(list + i + 1);
+        all_finite = _mm256_and_pd(all_finite, _mm256_cmp_pd(_mm256_and_pd(value, magnitude), infinity, _CMP_LT_OQ));
+        all_ascending = _mm256_and_pd(all_ascending, _mm256_cmp_pd(value, next, _CMP_LE_OQ));
+        all_descending = _mm256_and_pd(all_descending, _mm256_cmp_pd(value, next, _CMP_GE_OQ));
+    }
+    finite = (_mm256_movemask_pd(all_finite) == 0xF);
+    ascending = (_mm256_movemask_pd(all_ascending) == 0xF);
+    descending = (_mm256_movemask_pd(all_descending) == 0xF);
+#endif
+    for (; i < list_len; i++) {
+        finite &= (std::fabs(list[i]) < std::numeric_limits<double>::infinity());
+        if (i + 1 < list_len) {
+            ascending &= (list[i] <= list[i + 1]);
+            descending &= (list[i] >= list[i + 1]);
+        }
+    }
+    return { finite, ascending ? SortOrder::Ascending : (descending ? SortOrder::Descending : SortOrder::Unsorted) };
+}
 
-    // pH values at each temperature point for each pH buffer
-    const std::vector<std::vector<double>> ph_values = {
-        {1.67, 4.01, 6.98, 7.12, 9.46, 10.32, 13.47}, // 0°C
-        {1.67, 4.01, 6.95, 7.09, 9.39, 10.25, 13.25}, // 5°C
-        {1.67, 4.00, 6.92, 7.06, 9.32, 10.18, 13.03}, // 10°C
-        {1.67, 4.00, 6.90, 7.04, 9.27, 10.12, 12.83}, // 15°C
-        {1.68, 4.00, 6.88, 7.02, 9.22, 10.06, 12.64}, // 20°C
-        {1.68, 4.01, 6.86, 7.00, 9.18, 10.01, 12.46}, // 25°C
-        {1.69, 4.01, 6.85, 6.98, 9.14,  9.97, 12.29}, // 30°C
-        {1.69, 4.02, 6.84, 6.98, 9.10,  9.93, 12.14}, // 35°C
-        {1.70, 4.03, 6.84, 6.97, 9.07,  9.89, 11.99}, // 40°C
-        {1.70, 4.04, 6.83, 6.97, 9.04,  9.86, 11.86}, // 45°C
-        {1.71, 4.06, 6.83, 6.97, 9.01,  9.83, 11.73}, // 50°C
-        {1.72, 4.08, 6.83, 6.97, 8.99,  9.81, 11.61}  // 55°C
-    };
-    
-    // Initialize the object with the table and lists above 
-    InterpolableLUT lutPh(ph_values, ph_values_at_25, temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);    
-    
-    printf("pH: %.2f\n", lutPh.find(7.01, 37.0));
-    printf("pH: %.2f\n", lutPh.find(7.50, 37.0));
-    printf("pH: %.2f\n", lutPh.find(8.00, 37.0));
-    printf("pH: %.2f\n", lutPh.find(8.50, 37.0));
-    printf("pH: %.2f\n", lutPh.find(9.00, 37.0));
-    printf("pH: %.2f\n", lutPh.find(10.01, 0.01));
+inline LUTRowCheck lut_check_row(const float *list, int list_len) {
+    int i = 0;
+    bool finite = true;
+    bool ascending = true;
+    bool descending = true;
+#if defined(__AVX__)
+    const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 all_finite = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    __m256 all_ascending = all_finite;
+    __m256 all_descending = all_finite;
+    for (; i + 9 <= list_len; i += 8) {
+        __m256 value = _mm256_loadu_ps(list + i);
+        __m256 next = _mm256_loadu_ps(list + i + 1);
+        all_finite = _mm256_and_ps(all_finite, _mm256_cmp_ps(_mm256_and_ps(value, magnitude), infinity, _CMP_LT_OQ));
+        all_ascending = _mm256_and_ps(all_ascending, _mm256_cmp_ps(value, next, _CMP_LE_OQ));
+        all_descending = _mm256_and_ps(all_descending, _mm256_cmp_ps(value, next, _CMP_GE_OQ));
+    }
+    finite = (_mm256_movemask_ps(all_finite) == 0xFF);
+    ascending = (_mm256_movemask_ps(all_ascending) == 0xFF);
+    descending = (_mm256_movemask_ps(all_descending) == 0xFF);
+#endif
+    for (; i < list_len; i++) {
+        finite &= (std::fabs(list[i]) < std::numeric_limits<float>::infinity());
+        if (i + 1 < list_len) {
+            ascending &= (list[i] <= list[i + 1]);
+            descending &= (list[i] >= list[i + 1]);
+        }
+    }
+    return { finite, ascending ? SortOrder::Ascending : (descending ? SortOrder::Descending : SortOrder::Unsorted) };
+}
 
-    std::cout << lutPh;
-}
\ No newline at end of file
+/**
+ * @brief Branchless binary search for the bracket around search_val in a sorted list
+ * @details Finds the last index whose value is on the same side of search_val as list[0].
+ *      Brackets are closed at their numerically lower end in both directions, so a descending
+ *      list gives the same answers as its reverse. Ascending and descending lists only differ
+ *      in the comparison, so both directions compile to the same instruction sequence.
+ * @return true if the search value lies inside the list, false otherwise
+*/
+template <bool Descending, typename T, typename V>
+inline bool lut_bracket_sorted(const T *list, int list_len, V search_val, int *lower_result, int *upper_result) {
+    if (list_len < 2 || !(Descending ? (list[0] > search_val) : (list[0] <= search_val))) {
+        return false;
+    }
+    int first = 0;
+    int len = list_len;
+    while (len > 1) {
+        int half = len / 2;
+        V mid = (V)list[first + half];
+        first = (Descending ? (mid > search_val) : (mid <= search_val)) ? first + half : first;
+        len -= half;
+    }
+    if (first >= list_len - 1) {
+        return false;
+    }
+    *lower_result = first;
+    *upper_result = first + 1;
+    return true;
+}
+
+/**
+ * @brief Blends two rows that have missing cells
+ * @details A cell missing from one of the two rows takes the value of the other row (nearest
+ *      valid in the y-direction). Columns missing from both rows are left for the caller to
+ *      patch. The rows are blended by the dense kernel first, and then only the columns with a
+ *      missing cell are visited, by walking the set bits of each mask word.
+*/
+template <typename StorageT, typename ComputeT>
+inline void lut_blend_rows_masked(const StorageT *lower, const StorageT *upper,
+                                  const uint64_t *lower_valid, const uint64_t *upper_valid,
+                                  ComputeT t, ComputeT *out, int len) {
+    lut_blend_rows(lower, upper, t, out, len);
+    for (int word = 0; word < (len + 63) / 64; word++) {
+        uint64_t incomplete = ~(lower_valid[word] & upper_valid[word]);
+        if (word == (len - 1) / 64 && (len & 63)) {
+            incomplete &= ((uint64_t)1 << (len & 63)) - 1;
+        }
+        while (incomplete) {
+            int i = word * 64 + __builtin_ctzll(incomplete);
+            incomplete &= incomplete - 1;
+            bool lower_present = (lower_valid[word] >> (i & 63)) & 1;
+            out[i] = lower_present ? (ComputeT)lower[i] : (ComputeT)upper[i];
+        }
+    }
+}
+
+/**
+ * @brief How cells marked as missing in a table's validity mask are handled
+*/
+enum class MissingCells {
+    FillNearest,        ///< At construction, copy the nearest valid cell of the same column
+    FillInterpolate,    ///< At construction, interpolate linearly in y between the valid cells above and below
+    MaskPerQuery        ///< Keep the mask, and let find() skip missing cells
+};
+
+/**
+ * @brief How a lookup went
+*/
+enum class LookupOutcome {
+    Interpolated,   ///< Both inputs were inside the table
+    YOutOfRange,    ///< y_input was outside of the y-reference values, x_input was returned
+    XOutOfRange     ///< x_input was outside of the interpolated row, x_input was returned
+};
+
+/**
+ * @brief Bit pattern of a double, for probe arguments, which tracers only read as integers
+*/
+inline int64_t lut_probe_bits(double value) {
+    int64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/**
+ * @brief Which kernel blended the rows of a lookup
+*/
+enum class LookupKernel : uint8_t {
+    None,       ///< No rows were blended because y_input was out of range
+    Dense,      ///< lut_blend_rows()
+    Masked,     ///< lut_blend_rows_masked()
+    PairDelta,  ///< lut_blend_delta() on a TableLayout::PairDelta table
+    RowCache    ///< No blend, the row was taken from the thread's row cache, see setRowCache()
+};
+
+/**
+ * @brief Kernel used by find_batch()
+*/
+enum class BatchKernel {
+    Auto,       ///< Gather when the table supports it, Scalar otherwise
+    Scalar,     ///< find() for each query
+    Gather      ///< 4 queries at a time in AVX2 registers, see BasicInterpolableLUT::find_batch()
+};
+
+/**
+ * @brief New value of one table cell, for BasicInterpolableLUT::setCells()
+*/
+struct CellValue {
+    int row;
+    int column;
+    double value;
+};
+
+/**
+ * @brief How the rows blended by find() are stored
+*/
+enum class TableLayout {
+    RowMajor,   ///< Rows back to back; the blend reads two rows and subtracts them
+    PairDelta   ///< Also one block per adjacent row pair, the lower row then the difference to the upper row
+};
+
+/**
+ * @brief Details of one lookup, filled in by find() for metrics and tracing
+*/
+struct LookupInfo {
+    LookupOutcome outcome;
+    LookupKernel kernel;
+    SortOrder x_search;     ///< How the blended row was searched, Unsorted being a linear scan
+    int y_lower_idx;        ///< Lower row of the y bracket, -1 if there was none
+    int x_lower_idx;        ///< Lower column of the x bracket, -1 if there was none
+};
+
+inline uint64_t lut_next_table_id() {
+    static std::atomic<uint64_t> next_id(1);
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Lookup statistics of one or more tables
+ * @details Every thread that records gets its own cache-line aligned block of counters, found
+ *      through a one-entry thread-local cache and pushed onto a lock-free list on first use.
+ *      Only the owning thread writes a block, so recording is a relaxed load and store per
+ *      counter, with no locks and no shared cache lines. Readers sum the blocks, which is only
+ *      as consistent as a scrape needs to be.
+ *
+ *      Reading the clock costs more than the rest of a small lookup, so only every
+ *      latencySampleInterval()-th lookup of a thread is timed. The latency histogram counts
+ *      those samples only.
+*/
+class LUTMetrics {
+
+    public:
+        static constexpr int latency_bucket_count = 10;
+
+        /**
+         * @brief Upper bounds of the latency histogram buckets in nanoseconds, the last one is +Inf
+        */
+        static const uint64_t *latencyBoundsNs() {
+            static const uint64_t bounds[latency_bucket_count - 1] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 100000 };
+            return bounds;
+        }
+
+        explicit LUTMetrics(uint32_t latency_sample_interval = 16):sample_interval(std::max(1u, latency_sample_interval)) { }
+        LUTMetrics(const LUTMetrics &) = delete;
+        LUTMetrics &operator=(const LUTMetrics &) = delete;
+
+        ~LUTMetrics() {
+            ThreadCounters *counters = head.load(std::memory_order_acquire);
+            while (counters != nullptr) {
+                ThreadCounters *next = counters->next;
+                delete counters;
+                counters = next;
+            }
+        }
+
+        uint32_t latencySampleInterval() const {
+            return sample_interval;
+        }
+
+        /**
+         * @brief Whether the calling thread should time its next lookup
+        */
+        bool sampleLatency() {
+            ThreadCounters &counters = local();
+            if (--counters.until_sample == 0) {
+                counters.until_sample = sample_interval;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Records one lookup
+        */
+        void record(LookupOutcome outcome) {
+            ThreadCounters &counters = local();
+            bump(counters.lookups);
+            if (outcome == LookupOutcome::YOutOfRange) {
+                bump(counters.y_out_of_range);
+            } else if (outcome == LookupOutcome::XOutOfRange) {
+                bump(counters.x_out_of_range);
+            }
+        }
+
+        /**
+         * @brief Records one lookup that was timed
+        */
+        void record(LookupOutcome outcome, uint64_t latency_ns) {
+            record(outcome);
+            ThreadCounters &counters = local();
+            const uint64_t *bounds = latencyBoundsNs();
+            int bucket = 0;
+            while (bucket < latency_bucket_count - 1 && latency_ns > bounds[bucket]) {
+                bucket++;
+            }
+            bump(counters.latency_buckets[bucket]);
+            bump(counters.latency_sum_ns, latency_ns);
+        }
+
+        /**
+         * @brief Records a lookup of a cache in front of the table
+        */
+        void recordCache(bool hit) {
+            ThreadCounters &counters = local();
+            bump(hit ? counters.cache_hits : counters.cache_misses);
+        }
+
+        /**
+         * @brief Records the identity, version and size of the table being measured
+        */
+        void setTable(uint64_t id, uint64_t version, size_t memory_bytes) {
+            table_id.store(id, std::memory_order_relaxed);
+            table_version.store(version, std::memory_order_relaxed);
+            memory_usage.store(memory_bytes, std::memory_order_relaxed);
+        }
+
+        uint64_t lookups() const { return sum(&ThreadCounters::lookups); }
+        uint64_t yOutOfRange() const { return sum(&ThreadCounters::y_out_of_range); }
+        uint64_t xOutOfRange() const { return sum(&ThreadCounters::x_out_of_range); }
+        uint64_t cacheHits() const { return sum(&ThreadCounters::cache_hits); }
+        uint64_t cacheMisses() const { return sum(&ThreadCounters::cache_misses); }
+        uint64_t latencySumNs() const { return sum(&ThreadCounters::latency_sum_ns); }
+        uint64_t tableId() const { return table_id.load(std::memory_order_relaxed); }
+        uint64_t tableVersion() const { return table_version.load(std::memory_order_relaxed); }
+        uint64_t memoryUsage() const { return memory_usage.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Number of timed lookups that took at most latencyBoundsNs()[bucket], cumulative like Prometheus
+        */
+        uint64_t latencyCumulative(int bucket) const {
+            uint64_t total = 0;
+            for (const ThreadCounters *counters = head.load(std::memory_order_acquire); counters != nullptr; counters = counters->next) {
+                for (int b = 0; b <= bucket; b++) {
+                    total += counters->latency_buckets[b].load(std::memory_order_relaxed);
+                }
+            }
+            return total;
+        }
+
+    private:
+        struct alignas(64) ThreadCounters {
+            std::atomic<uint64_t> lookups{0};
+            std::atomic<uint64_t> y_out_of_range{0};
+            std::atomic<uint64_t> x_out_of_range{0};
+            std::atomic<uint64_t> cache_hits{0};
+            std::atomic<uint64_t> cache_misses{0};
+            std::atomic<uint64_t> latency_sum_ns{0};
+            std::atomic<uint64_t> latency_buckets[latency_bucket_count] = {};
+            uint32_t until_sample = 1;  ///< Lookups until the next timed one, owner thread only
+            std::thread::id owner;
+            ThreadCounters *next = nullptr;
+
+            // Plain new only honours alignas(64) from C++17 on, so blocks are aligned by hand,
+            // with the pointer to free kept just below the block
+            static void *operator new(size_t size) {
+                char *raw = (char *)::operator new(size + 64);
+                char *block = raw + 64 - (size_t)((uintptr_t)raw % 64);
+                ((void **)block)[-1] = raw;
+                return block;
+            }
+
+            static void operator delete(void *block) {
+                ::operator delete(((void **)block)[-1]);
+            }
+        };
+
+        const uint64_t instance_id = lut_next_table_id();  ///< Tells a new LUTMetrics apart from a deleted one at the same address
+        const uint32_t sample_interval;
+        std::atomic<ThreadCounters *> head{nullptr};
+        std::atomic<uint64_t> table_id{0};
+        std::atomic<uint64_t> table_version{0};
+        std::atomic<uint64_t> memory_usage{0};
+
+        /**
+         * @brief Adds to a counter only the calling thread writes
+        */
+        static void bump(std::atomic<uint64_t> &counter, uint64_t amount = 1) {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        ThreadCounters &local() {
+            thread_local uint64_t cached_instance = 0;
+            thread_local ThreadCounters *cached = nullptr;
+            if (cached_instance == instance_id) {
+                return *cached;
+            }
+            std::thread::id self = std::this_thread::get_id();
+            ThreadCounters *counters = head.load(std::memory_order_acquire);
+            while (counters != nullptr && counters->owner != self) {
+                counters = counters->next;
+            }
+            if (counters == nullptr) {
+                counters = new ThreadCounters();
+                counters->owner = self;
+                counters->next = head.load(std::memory_order_relaxed);
+                while (!head.compare_exchange_weak(counters->next, counters, std::memory_order_release, std::memory_order_relaxed)) {
+                }
+            }
+            cached_instance = instance_id;
+            cached = counters;
+            return *counters;
+        }
+
+        uint64_t sum(std::atomic<uint64_t> ThreadCounters::*counter) const {
+            uint64_t total = 0;
+            for (const ThreadCounters *counters = head.load(std::memory_order_acquire); counters != nullptr; counters = counters->next) {
+                total += (counters->*counter).load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+};
+
+/**
+ * @brief Named LUTMetrics of a process, rendered together in Prometheus text exposition format
+ * @details Registering and rendering take a lock, recording into a registered LUTMetrics does not.
+ *      Registered metrics must stay alive until they are unregistered.
+*/
+class LUTMetricsRegistry {
+
+    public:
+        /**
+         * @brief Registers metrics under name, which is used as the table label as is
+        */
+        void add(const std::string &name, const LUTMetrics *metrics) {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.push_back({ name, metrics });
+        }
+
+        void remove(const LUTMetrics *metrics) {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                         [metrics](const Entry &entry) { return entry.metrics == metrics; }),
+                          entries.end());
+        }
+
+        /**
+         * @brief Writes the exposition text into buffer
+         * @return Length of the full text. Like snprintf, if that is not less than capacity the text
+         *      was truncated, and a buffer of the returned length plus one is enough.
+        */
+        size_t render(char *buffer, size_t capacity) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            Writer out(buffer, capacity);
+            write_family(out, "lut_lookups_total", "counter", "Lookups served by find()",
+                         [](Writer &w, const std::string &label, const LUTMetrics &m) {
+                             w.printf("lut_lookups_total{table=\"%s\"} %llu\n", label.c_str(), (unsigned long long)m.lookups());
+                         });
+            write_family(out, "lut_out_of_range_total", "counter", "Lookups that returned x_input because an input was outside of the table",
+                         [](Writer &w, const std::string &label, const LUTMetrics &m) {
+                             w.printf("lut_out_of_range_total{table=\"%s\",axis=\"y\"} %llu\n", label.c_str(), (unsigned long long)m.yOutOfRange());
+                             w.printf("lut_out_of_range_total{table=\"%s\",axis=\"x\"} %llu\n", label.c_str(), (unsigned long long)m.xOutOfRange());
+                         });
+            write_family(out, "lut_cache_hits_total", "counter", "Lookups answered by a cache in front of the table",
+                         [](Writer &w, const std::string &label, const LUTMetrics &m) {
+                             w.printf("lut_cache_hits_total{table=\"%s\"} %llu\n", label.c_str(), (unsigned long long)m.cacheHits());
+                         });
+            write_family(out, "lut_cache_misses_total", "counter", "Lookups a cache in front of the table had to pass on",
+                         [](Writer &w, const std::string &label, const LUTMetrics &m) {
+                             w.printf("lut_cache_misses_total{table=\"%s\"} %llu\n", label.c_str(), (unsigned long long)m.cacheMisses());
+                         });
+            write_family(out, "lut_lookup_latency_seconds", "histogram", "Time spent in find(), sampled every latencySampleInterval() lookups",
+                         [](Writer &w, const std::string &label, const LUTMetrics &m) {
+                             for (int b = 0; b < LUTMetrics::latency_bucket_count - 1; b++) {
+                                 w.printf("lut_lookup_latency_seconds_bucket{table=\"%s\",le=\"%g\"} %llu\n", label.c_str(),
+                                          LUTMetrics::latencyBoundsNs()[b] * 1e-9, (unsigned long long)m.latencyCumulative(b));
+                             }
+                             uint64_t count = m.latencyCumulative(LUTMetrics::latency_bucket_count - 1);
+                             w.printf("lut_lookup_latency_seconds_bucket{table=\"%s\",le=\"+Inf\"} %llu\n", label.c_str(), (unsigned long long)count);
+                             w.printf("lut_lookup_latency_seconds_sum{table=\"%s\"} %.9f\n", label.c_str(), m.latencySumNs() * 1e-9);
+                             w.printf("lut_lookup_latency_seconds_count{table=\"%s\"} %llu\n", label.c_str(), (unsigned long long)count);
+                         });
+            write_family(out, "lut_memory_bytes", "gauge", "Memory used by the table",
+                         [](Writer &w, const std::string &label, const LUTMetrics &m) {
+                             w.printf("lut_memory_bytes{table=\"%s\"} %llu\n", label.c_str(), (unsigned long long)m.memoryUsage());
+                         });
+            write_family(out, "lut_table_version", "gauge", "Version of the table currently serving lookups",
+                         [](Writer &w, const std::string &label, const LUTMetrics &m) {
+                             w.printf("lut_table_version{table=\"%s\",id=\"%llu\"} %llu\n", label.c_str(),
+                                      (unsigned long long)m.tableId(), (unsigned long long)m.tableVersion());
+                         });
+            return out.length();
+        }
+
+        /**
+         * @brief Renders into a complete HTTP/1.1 response, as a /metrics endpoint would send it
+         * @details The body is rendered once, straight into buffer behind room kept for the
+         *      header, so Content-Length always matches the body that follows it even while
+         *      lookups keep counting.
+         * @return Length of the response. If that is not less than capacity buffer holds an empty string,
+         *      and a buffer of the returned length plus one fits the response at the time of the call.
+        */
+        size_t renderHttpResponse(char *buffer, size_t capacity) const {
+            static const char header_format[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n";
+            char header[sizeof(header_format) + 20];
+            size_t reserved = (size_t)snprintf(header, sizeof(header), header_format, SIZE_MAX);
+            size_t room = (capacity > reserved) ? capacity - reserved : 0;
+            size_t body_length = render(room > 0 ? buffer + reserved : nullptr, room);
+            if (body_length >= room) {
+                if (capacity > 0) {
+                    buffer[0] = '\0';
+                }
+                return reserved + body_length;
+            }
+            size_t header_length = (size_t)snprintf(header, sizeof(header), header_format, body_length);
+            memmove(buffer + header_length, buffer + reserved, body_length + 1);
+            memcpy(buffer, header, header_length);
+            return header_length + body_length;
+        }
+
+        /**
+         * @brief Writes the exposition text to path, e.g. for the node_exporter textfile collector
+         * @details The text goes to a temporary file first that is renamed over path, so a reader
+         *      never sees a partial file. It is rendered into a buffer kept between calls, which
+         *      only grows when the text no longer fits.
+         * @return false if the file could not be written
+        */
+        bool writeFile(const std::string &path) const {
+            std::lock_guard<std::mutex> lock(file_mutex);
+            size_t length = render(file_buffer.data(), file_buffer.size());
+            while (length >= file_buffer.size()) {
+                file_buffer.resize(length + length / 4 + 1);
+                length = render(file_buffer.data(), file_buffer.size());
+            }
+            std::string temporary = path + ".tmp";
+            FILE *file = fopen(temporary.c_str(), "w");
+            if (file == nullptr) {
+                return false;
+            }
+            bool written = fwrite(file_buffer.data(), 1, length, file) == length;
+            written &= (fclose(file) == 0);
+            return written && rename(temporary.c_str(), path.c_str()) == 0;
+        }
+
+    private:
+        struct Entry {
+            std::string name;
+            const LUTMetrics *metrics;
+        };
+
+        /**
+         * @brief snprintf into a fixed buffer that keeps counting once the buffer is full
+        */
+        class Writer {
+            public:
+                Writer(char *buffer, size_t capacity):buffer(buffer), capacity(capacity), used(0) {
+                    if (capacity > 0) {
+                        buffer[0] = '\0';
+                    }
+                }
+
+                template <typename... Args>
+                void printf(const char *format, Args... args) {
+                    size_t room = (used < capacity) ? capacity - used : 0;
+                    int written = snprintf(room > 0 ? buffer + used : nullptr, room, format, args...);
+                    used += (written > 0) ? (size_t)written : 0;
+                }
+
+                size_t length() const { return used; }
+
+            private:
+                char *buffer;
+                size_t capacity;
+                size_t used;
+        };
+
+        template <typename F>
+        void write_family(Writer &out, const char *name, const char *type, const char *help, F write_samples) const {
+            out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+            for (const Entry &entry : entries) {
+                write_samples(out, entry.name, *entry.metrics);
+            }
+        }
+
+        mutable std::mutex mutex;
+        std::vector<Entry> entries;
+        mutable std::mutex file_mutex;           ///< Guards file_buffer
+        mutable std::vector<char> file_buffer;   ///< Reused by writeFile()
+};
+
+/**
+ * @brief One traced lookup, as written to the trace rings and to dump files
+*/
+struct LUTTraceRecord {
+    uint64_t timestamp_ns;  ///< steady_clock time the lookup started
+    uint64_t table_id;      ///< BasicInterpolableLUT::getTableId()
+    double x_input;
+    double y_input;
+    double result;
+    int32_t y_lower_idx;    ///< Lower row of the y bracket, -1 if there was none
+    int32_t x_lower_idx;    ///< Lower column of the x bracket, -1 if there was none
+    uint32_t duration_ns;
+    uint8_t outcome;        ///< LookupOutcome
+    uint8_t kernel;         ///< LookupKernel
+    uint8_t x_search;       ///< SortOrder used to search the blended row
+    uint8_t reserved;
+};
+
+/**
+ * @brief Optional flight recorder of individual lookups
+ * @details While enabled, every find() writes a LUTTraceRecord into a ring owned by the calling
+ *      thread, overwriting the oldest record once the ring is full. Rings are created on a
+ *      thread's first traced lookup and pushed onto a lock-free list, so lookups never lock.
+ *      Each slot is guarded by a sequence number, which lets dump() copy rings while their
+ *      threads keep writing and skip slots caught mid-write. While disabled, find() pays one
+ *      relaxed load.
+ *
+ *      Dump files are a FileHeader followed by records, and are decoded by decode().
+*/
+class LUTTracer {
+
+    public:
+        struct FileHeader {
+            char magic[8];          ///< "LUTTRACE"
+            uint32_t version;       ///< 1
+            uint32_t record_size;   ///< sizeof(LUTTraceRecord)
+            uint64_t record_count;
+        };
+
+        static bool enabled() {
+            return flag().load(std::memory_order_relaxed);
+        }
+
+        static void enable(bool on) {
+            flag().store(on, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Records per ring, for threads that start tracing after the call. Rounded up to a power of two.
+        */
+        static void setRingCapacity(size_t records) {
+            size_t capacity = 1;
+            while (capacity < records) {
+                capacity *= 2;
+            }
+            ring_capacity().store(capacity, std::memory_order_relaxed);
+        }
+
+        static void record(const LUTTraceRecord &record) {
+            Ring &ring = local();
+            uint64_t position = ring.head.load(std::memory_order_relaxed);
+            Slot &slot = ring.slots[position & (ring.capacity - 1)];
+            slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.record = record;
+            slot.sequence.store(2 * position + 2, std::memory_order_release);
+            ring.head.store(position + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Copies the records currently held by every ring, oldest first within each ring
+        */
+        static std::vector<LUTTraceRecord> snapshot() {
+            std::vector<LUTTraceRecord> records;
+            for (Ring *ring = rings().load(std::memory_order_acquire); ring != nullptr; ring = ring->next) {
+                uint64_t head = ring->head.load(std::memory_order_acquire);
+                uint64_t first = (head > ring->capacity) ? head - ring->capacity : 0;
+                for (uint64_t position = first; position < head; position++) {
+                    Slot &slot = ring->slots[position & (ring->capacity - 1)];
+                    uint64_t before = slot.sequence.load(std::memory_order_acquire);
+                    LUTTraceRecord copy = slot.record;
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (before == 2 * position + 2 && slot.sequence.load(std::memory_order_relaxed) == before) {
+                        records.push_back(copy);
+                    }
+                }
+            }
+            return records;
+        }
+
+        /**
+         * @brief Writes snapshot() to a binary file
+         * @return false if the file could not be written
+        */
+        static bool dump(const std::string &path) {
+            std::vector<LUTTraceRecord> records = snapshot();
+            FileHeader header = { { 'L', 'U', 'T', 'T', 'R', 'A', 'C', 'E' }, 1, (uint32_t)sizeof(LUTTraceRecord), records.size() };
+            FILE *file = fopen(path.c_str(), "wb");
+            if (file == nullptr) {
+                return false;
+            }
+            bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+            written &= fwrite(records.data(), sizeof(LUTTraceRecord), records.size(), file) == records.size();
+            return (fclose(file) == 0) && written;
+        }
+
+        /**
+         * @brief Decodes a dump file into one line of text per record, ordered by time
+         * @return false if the file is missing, is not a trace dump or holds fewer records than its header claims
+        */
+        static bool decode(const std::string &path, std::ostream &os) {
+            FILE *file = fopen(path.c_str(), "rb");
+            if (file == nullptr) {
+                return false;
+            }
+            FileHeader header;
+            bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "LUTTRACE", 8) == 0 &&
+                      header.version == 1 && header.record_size == sizeof(LUTTraceRecord);
+            // A corrupt record_count must not size the allocation, so check it against the bytes that follow
+            long records_start = ok ? ftell(file) : -1;
+            ok = ok && records_start >= 0 && fseek(file, 0, SEEK_END) == 0;
+            long file_end = ok ? ftell(file) : -1;
+            ok = ok && file_end >= records_start && fseek(file, records_start, SEEK_SET) == 0 &&
+                 header.record_count <= (uint64_t)(file_end - records_start) / sizeof(LUTTraceRecord);
+            std::vector<LUTTraceRecord> records(ok ? header.record_count : 0);
+            ok = ok && fread(records.data(), sizeof(LUTTraceRecord), records.size(), file) == records.size();
+            fclose(file);
+            if (!ok) {
+                return false;
+            }
+
+            std::sort(records.begin(), records.end(), [](const LUTTraceRecord &a, const LUTTraceRecord &b) {
+                return a.timestamp_ns < b.timestamp_ns;
+            });
+            static const char *outcomes[] = { "ok", "y-out", "x-out" };
+            static const char *kernels[] = { "none", "dense", "masked", "delta", "cached" };
+            static const char *searches[] = { "asc", "desc", "scan" };
+            char line[256];
+            for (const LUTTraceRecord &r : records) {
+                snprintf(line, sizeof(line), "%llu table=%llu x=%.6g y=%.6g -> %.6g rows=%d cols=%d %s %s/%s %uns\n",
+                         (unsigned long long)r.timestamp_ns, (unsigned long long)r.table_id, r.x_input, r.y_input, r.result,
+                         r.y_lower_idx, r.x_lower_idx, outcomes[r.outcome % 3], kernels[r.kernel % 5], searches[r.x_search % 3],
+                         r.duration_ns);
+                os << line;
+            }
+            return true;
+        }
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> sequence{0};  ///< 2 * position + 2 once the record at position is complete
+            LUTTraceRecord record;
+        };
+
+        struct Ring {
+            size_t capacity;
+            std::atomic<uint64_t> head{0};
+            std::vector<Slot> slots;
+            Ring *next = nullptr;
+
+            explicit Ring(size_t capacity):capacity(capacity), slots(capacity) { }
+        };
+
+        static std::atomic<bool> &flag() {
+            static std::atomic<bool> on(false);
+            return on;
+        }
+
+        static std::atomic<size_t> &ring_capacity() {
+            static std::atomic<size_t> capacity(4096);
+            return capacity;
+        }
+
+        static std::atomic<Ring *> &rings() {
+            static std::atomic<Ring *> head(nullptr);
+            return head;
+        }
+
+        /**
+         * @brief The calling thread's ring. Rings outlive their threads so that a dump still shows them.
+        */
+        static Ring &local() {
+            thread_local Ring *ring = nullptr;
+            if (ring == nullptr) {
+                ring = new Ring(ring_capacity().load(std::memory_order_relaxed));
+                ring->next = rings().load(std::memory_order_relaxed);
+                while (!rings().compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed)) {
+                }
+            }
+            return *ring;
+        }
+};
+
+/**
+ * @brief Writes the transpose of the rows x columns matrix src, row-major, to dst as columns x rows
+ * @details Works in tiles of 32 x 32, so both the rows read from src and the rows written to dst
+ *      stay in cache while a tile is copied, instead of one of them missing on every element.
+ *      Strips of 32 columns of src, which are 32 whole rows of dst, are split over the executor
+ *      unless the matrix is small.
+*/
+template <typename T>
+void lut_transpose(const T *src, size_t rows, size_t columns, T *dst, LUTExecutor &executor = LUTExecutor::shared()) {
+    const size_t tile = 32;
+    size_t strips = (columns + tile - 1) / tile;
+    auto copy = [=](size_t begin, size_t end) {
+        for (size_t strip = begin; strip < end; strip++) {
+            size_t column_end = std::min(columns, (strip + 1) * tile);
+            for (size_t row_begin = 0; row_begin < rows; row_begin += tile) {
+                size_t row_end = std::min(rows, row_begin + tile);
+                for (size_t column = strip * tile; column < column_end; column++) {
+                    for (size_t row = row_begin; row < row_end; row++) {
+                        dst[column * rows + row] = src[row * columns + column];
+                    }
+                }
+            }
+        }
+    };
+    if (rows * columns < ((size_t)1 << 16)) {
+        copy(0, strips);
+    } else {
+        executor.parallel_for(strips, 1, copy);
+    }
+}
+
+template <typename StorageT, typename ComputeT = StorageT>
+class BasicInterpolableLUT {
+
+    public:
+        typedef StorageT storage_type;
+        typedef ComputeT compute_type;
+
+        BasicInterpolableLUT(const std::vector<std::vector<double>> (&table),
+                             const std::vector<double> x_ref,
+                             const std::vector<double> y_ref,
+                             int x_len,
+                             int y_len):x_len(x_len), y_len(y_len), x_ref(x_ref.begin(), x_ref.end()), y_ref(y_ref.begin(), y_ref.end()) {
+            LUT_PROBE(table__load__entry, table_id, x_len, y_len);
+            load_table(table, true);
+            detect_pair_orders();
+            LUT_PROBE(table__load__return, table_id, x_len, y_len, (int)!this->valid.empty());
+        }
+
+        /**
+         * @brief Creates a table with missing cells
+         * @param valid y_len rows of x_len flags, false where the table has no measurement
+         * @param missing Whether missing cells are filled in now or skipped by every find()
+        */
+        BasicInterpolableLUT(const std::vector<std::vector<double>> (&table),
+                             const std::vector<std::vector<bool>> (&valid),
+                             MissingCells missing,
+                             const std::vector<double> x_ref,
+                             const std::vector<double> y_ref,
+                             int x_len,
+                             int y_len):x_len(x_len), y_len(y_len), x_ref(x_ref.begin(), x_ref.end()), y_ref(y_ref.begin(), y_ref.end()) {
+            LUT_PROBE(table__load__entry, table_id, x_len, y_len);
+            load_table(table, false);
+            if (valid.size() != (size_t)y_len) {
+                throw std::invalid_argument("The mask needs y_len rows");
+            }
+            mask_words = (x_len + 63) / 64;
+            this->valid.assign((size_t)mask_words * y_len, 0);
+            for (int row = 0; row < y_len; row++) {
+                if (valid[row].size() != (size_t)x_len) {
+                    throw std::invalid_argument("Every mask row needs x_len flags");
+                }
+                for (int i = 0; i < x_len; i++) {
+                    if (valid[row][i]) {
+                        if (!std::isfinite((double)this->table[(size_t)row * x_len + i])) {
+                            throw std::invalid_argument("Table values must be finite where the mask has data");
+                        }
+                        this->valid[(size_t)row * mask_words + (i >> 6)] |= (uint64_t)1 << (i & 63);
+                    } else {
+                        this->table[(size_t)row * x_len + i] = 0;
+                    }
+                }
+            }
+            if (missing != MissingCells::MaskPerQuery) {
+                fill_missing(missing == MissingCells::FillInterpolate);
+                this->valid.clear();
+                mask_words = 0;
+            } else {
+                find_gaps();
+            }
+            detect_orders();
+            LUT_PROBE(table__load__return, table_id, x_len, y_len, (int)!this->valid.empty());
+        }
+
+        ~BasicInterpolableLUT() { }
+
+        /**
+         * @brief Copies the table, which gets its own identity, see getTableId()
+        */
+        BasicInterpolableLUT(const BasicInterpolableLUT &source) {
+            copy_contents(source);
+        }
+
+        BasicInterpolableLUT &operator=(const BasicInterpolableLUT &source) {
+            if (this != &source) {
+                copy_contents(source);
+                table_id = lut_next_table_id();
+            }
+            return *this;
+        }
+
+        BasicInterpolableLUT(BasicInterpolableLUT &&) = default;
+        BasicInterpolableLUT &operator=(BasicInterpolableLUT &&) = default;
+
+        /**
+         * @brief The same calibration with the roles of the axes swapped
+         * @details The result searches along the y-reference values and interpolates between the
+         *      x-reference values, so find(value, x) gives the y at which the table reaches value
+         *      at x. It is built from the flat table by lut_transpose() rather than through nested
+         *      rows, and a mask is transposed with it. The layout, y integrals and row cache
+         *      setting carry over, metrics do not, and the table gets its own identity.
+        */
+        BasicInterpolableLUT transposed(LUTExecutor &executor = LUTExecutor::shared()) const {
+            return BasicInterpolableLUT(*this, executor);
+        }
+
+        /**
+         * @brief Calculates the standardized (based on the reference lists) value for x_input
+         * @details Uses interpolation in the y-direction to create a temporary 'row' in the
+         *      x-direction
+        */
+        double find(double x_input, double y_input) {
+            thread_local std::vector<ComputeT> interpolated_y_values_at_x;
+            if (interpolated_y_values_at_x.size() < 2 * (size_t)x_len) {
+                interpolated_y_values_at_x.resize(2 * (size_t)x_len);
+            }
+            LUTMetrics *recorder = metrics;
+            bool tracing = LUTTracer::enabled();
+            if (recorder == nullptr && !tracing) {
+                return find(x_input, y_input, interpolated_y_values_at_x.data(), nullptr);
+            }
+            return find_observed(x_input, y_input, interpolated_y_values_at_x.data(), recorder, tracing);
+        }
+
+        /**
+         * @brief Looks up each of the len (x, y) pairs, writing the results to out
+         * @details The Gather kernel works on 4 queries at once without building blended rows.
+         *      The y bracket and then the x bracket are found by binary searches whose probes
+         *      are gathered from the flat table and blended in registers, and the result comes
+         *      from the four corner cells of each query's cell. It gives the same results as
+         *      find(). It needs an AVX2 build, double arithmetic (InterpolableLUT or
+         *      InterpolableLUTMixed), sorted reference values, every row pair sorted the same way
+         *      and no mask. It is skipped while metrics or tracing are on, so that every query is
+         *      still recorded. out may be the same buffer as x_input or y_input.
+        */
+        void find_batch(const double *x_input, const double *y_input, double *out, size_t len,
+                        BatchKernel kernel = BatchKernel::Auto) {
+            LUT_PROBE(batch__entry, table_id, len);
+            size_t done = 0;
+#if defined(__AVX2__)
+            if (kernel != BatchKernel::Scalar && batchKernel() == BatchKernel::Gather &&
+                metrics == nullptr && !LUTTracer::enabled()) {
+                bool y_descending = (y_order == SortOrder::Descending);
+                bool x_descending = (batch_order == SortOrder::Descending);
+                if (y_descending) {
+                    done = x_descending ? find_batch_gather<true, true>(x_input, y_input, out, len)
+                                        : find_batch_gather<true, false>(x_input, y_input, out, len);
+                } else {
+                    done = x_descending ? find_batch_gather<false, true>(x_input, y_input, out, len)
+                                        : find_batch_gather<false, false>(x_input, y_input, out, len);
+                }
+            }
+#else
+            (void)kernel;
+#endif
+            for (size_t i = done; i < len; i++) {
+                out[i] = find(x_input[i], y_input[i]);
+            }
+            LUT_PROBE(batch__return, table_id, len);
+        }
+
+        /**
+         * @brief find_batch() split over an executor in ranges of grain queries
+        */
+        void find_batch_parallel(const double *x_input, const double *y_input, double *out, size_t len,
+                                 LUTExecutor &executor = LUTExecutor::shared(), size_t grain = 1024) {
+            executor.parallel_for(len, grain, [=](size_t begin, size_t end) {
+                find_batch(x_input + begin, y_input + begin, out + begin, end - begin);
+            });
+        }
+
+        /**
+         * @brief Kernel find_batch() uses for BatchKernel::Auto
+        */
+        BatchKernel batchKernel() const {
+#if defined(__AVX2__)
+            if (std::is_same<ComputeT, double>::value && valid.empty() && x_len >= 2 && y_len >= 2 &&
+                y_order != SortOrder::Unsorted && batch_order != SortOrder::Unsorted) {
+                return BatchKernel::Gather;
+            }
+#endif
+            return BatchKernel::Scalar;
+        }
+
+        /**
+         * @brief Identity of this table, unique among all tables created by the process, copies included
+        */
+        uint64_t getTableId() const {
+            return table_id;
+        }
+
+        /**
+         * @brief Takes over the identity of source, for a copy that is published as a new version of it
+         * @details Copies get their own identity, so that caches keyed by identity and version,
+         *      like SeriesResultCache, never mistake one copy for another. Only hand an identity
+         *      on when the copy replaces source, and give it a higher version.
+        */
+        void shareTableId(const BasicInterpolableLUT &source) {
+            table_id = source.table_id;
+            if (metrics != nullptr) {
+                metrics->setTable(table_id, version, memory_usage());
+            }
+        }
+
+        /**
+         * @brief Version of the table contents, for callers that publish updated tables
+        */
+        uint64_t getVersion() const {
+            return version;
+        }
+
+        void setVersion(uint64_t new_version) {
+            version = new_version;
+            if (metrics != nullptr) {
+                metrics->setTable(table_id, version, memory_usage());
+            }
+        }
+
+        /**
+         * @brief Starts recording every find() into metrics, or stops if metrics is nullptr
+         * @details metrics must outlive the table or be detached first. Tables without metrics
+         *      pay one pointer check per lookup.
+        */
+        void attachMetrics(LUTMetrics *new_metrics) {
+            metrics = new_metrics;
+            if (metrics != nullptr) {
+                metrics->setTable(table_id, version, memory_usage());
+            }
+        }
+
+        /**
+         * @brief Lets find() keep up to entries blended rows per thread, 0 to stop
+         * @details Each thread keeps its own few rows, keyed by the exact y_input, the table and
+         *      its version and layout, so runs of lookups at one y on a thread blend the rows once
+         *      and then only search. A hit costs a compare per entry instead of an x_len blend, a
+         *      miss evicts the least recently used row. The rows of all tables on a thread share
+         *      the largest setting of any of them. Hits and misses are recorded by attached
+         *      metrics (LUTMetrics::cacheHits()), and traced lookups report LookupKernel::RowCache.
+         *      Results are the same as without the cache. Call it before the table is shared
+         *      between threads.
+        */
+        void setRowCache(size_t entries) {
+            row_cache_entries = entries;
+        }
+
+        size_t getRowCache() const {
+            return row_cache_entries;
+        }
+
+        /**
+         * @brief Switches the storage find() blends from
+         * @details TableLayout::PairDelta keeps, next to the row-major table, a block per adjacent
+         *      row pair holding the lower row and the upper minus lower row in the compute type.
+         *      The blend then streams one block with one multiply-add per value and gives the same
+         *      results as RowMajor, at about 2 * sizeof(ComputeT) / sizeof(StorageT) times the
+         *      table memory on top, so it pays off while the pair blocks stay in cache (see
+         *      benchmark_layout()). Not available for tables with a mask. Call it before the table
+         *      is shared between threads.
+        */
+        void setLayout(TableLayout new_layout) {
+            if (new_layout == TableLayout::PairDelta && !valid.empty()) {
+                throw std::invalid_argument("The PairDelta layout needs a table without a mask");
+            }
+            layout = new_layout;
+            pair_table.clear();
+            if (layout == TableLayout::PairDelta) {
+                pair_table.resize(2 * (size_t)x_len * (y_len - 1));
+                for (int pair = 0; pair + 1 < y_len; pair++) {
+                    const StorageT *lower = &table[(size_t)pair * x_len];
+                    const StorageT *upper = &table[(size_t)(pair + 1) * x_len];
+                    ComputeT *base = &pair_table[2 * (size_t)pair * x_len];
+                    for (int i = 0; i < x_len; i++) {
+                        base[i] = (ComputeT)lower[i];
+                        base[x_len + i] = (ComputeT)upper[i] - (ComputeT)lower[i];
+                    }
+                }
+            }
+            if (metrics != nullptr) {
+                metrics->setTable(table_id, version, memory_usage());
+            }
+        }
+
+        TableLayout getLayout() const {
+            return layout;
+        }
+
+        /**
+         * @brief Overwrites cells and refreshes everything find() derives from them
+         * @details Sort orders are detected again for the rows the cells are in, in O(x_len) each,
+         *      as are the PairDelta blocks and Y integrals of their columns when those are on. The
+         *      version goes up by one. Cells missing from a masked table cannot be set. Not safe
+         *      while other threads search the table; publish a changed copy instead, as
+         *      LUTRecalibrator does.
+        */
+        void setCells(const CellValue *cells, size_t count) {
+            for (size_t c = 0; c < count; c++) {
+                if (cells[c].row < 0 || cells[c].column < 0 || cells[c].row >= y_len || cells[c].column >= x_len) {
+                    throw std::out_of_range("Cell index out of range");
+                }
+                if (!is_valid(cells[c].row, cells[c].column)) {
+                    throw std::invalid_argument("Cannot set a cell that is missing from the mask");
+                }
+                if (!std::isfinite(cells[c].value)) {
+                    throw std::invalid_argument("Table values must be finite; mark missing cells with a mask instead");
+                }
+            }
+            thread_local std::vector<char> row_touched;
+            thread_local std::vector<char> column_touched;
+            row_touched.assign(y_len, 0);
+            column_touched.assign(x_len, 0);
+            for (size_t c = 0; c < count; c++) {
+                int row = cells[c].row;
+                int i = cells[c].column;
+                table[(size_t)row * x_len + i] = (StorageT)cells[c].value;
+                row_touched[row] = 1;
+                column_touched[i] = 1;
+                if (!pair_table.empty()) {
+                    for (int pair = std::max(row - 1, 0); pair <= std::min(row, y_len - 2); pair++) {
+                        ComputeT *base = &pair_table[2 * (size_t)pair * x_len];
+                        base[i] = (ComputeT)table[(size_t)pair * x_len + i];
+                        base[x_len + i] = (ComputeT)table[(size_t)(pair + 1) * x_len + i] - base[i];
+                    }
+                }
+            }
+            for (int row = 0; row < y_len; row++) {
+                if (row_touched[row]) {
+                    detect_row_order(row);
+                }
+            }
+            for (int row = 0; row < y_len - 1; row++) {
+                if (row_touched[row] || row_touched[row + 1]) {
+                    detect_pair_order(row);
+                }
+            }
+            detect_batch_order();
+            if (!y_integral.empty()) {
+                for (int i = 0; i < x_len; i++) {
+                    if (column_touched[i]) {
+                        for (int cell = 0; cell + 1 < y_len; cell++) {
+                            y_integral[(size_t)(cell + 1) * x_len + i] = y_integral[(size_t)cell * x_len + i] + cell_integral(i, cell);
+                        }
+                    }
+                }
+            }
+            setVersion(version + 1);
+        }
+
+        /**
+         * @brief Precomputes, or drops, the running integral of every column along y for findMean()
+         * @details Adds y_len * x_len doubles. Call it before the table is shared between threads.
+        */
+        void setYIntegrals(bool enable) {
+            y_integral.clear();
+            if (enable) {
+                if (!valid.empty()) {
+                    throw std::invalid_argument("Y integrals need a table without a mask");
+                }
+                y_integral.assign((size_t)x_len * y_len, 0);
+                for (int cell = 0; cell + 1 < y_len; cell++) {
+                    for (int i = 0; i < x_len; i++) {
+                        y_integral[(size_t)(cell + 1) * x_len + i] = y_integral[(size_t)cell * x_len + i] + cell_integral(i, cell);
+                    }
+                }
+            }
+            if (metrics != nullptr) {
+                metrics->setTable(table_id, version, memory_usage());
+            }
+        }
+
+        bool hasYIntegrals() const {
+            return !y_integral.empty();
+        }
+
+        /**
+         * @brief Standardized value for x_input against the table averaged over y from y_from to y_to
+         * @details Each column of the table is averaged over the interval, exactly for the piecewise
+         *      linear y-interpolation find() uses, and x_input is then searched in that mean row like
+         *      find() searches a blended row. With setYIntegrals() a column mean costs O(1) after
+         *      two bracket searches for the ends of the interval, and a binary search of a sorted
+         *      mean row only averages the columns it probes. Without, the rows inside the interval
+         *      are summed up for each probed column.
+         *
+         *      This is compensation by the mean characteristic over the interval. It differs from
+         *      the mean of find() over the interval only by the curvature of find() in y, which
+         *      benchmark_y_means() measures.
+         * @return The standardized value, or x_input if it or the interval is out of range of the table
+        */
+        double findMean(double x_input, double y_from, double y_to) {
+            if (!valid.empty()) {
+                throw std::invalid_argument("findMean() needs a table without a mask");
+            }
+            if (y_order == SortOrder::Unsorted) {
+                throw std::invalid_argument("findMean() needs sorted y-reference values");
+            }
+            if (y_from > y_to) {
+                std::swap(y_from, y_to);
+            }
+            if (y_len < 1) {
+                return x_input;
+            }
+            if (!(y_from >= std::min(y_ref.front(), y_ref.back()) && y_to <= std::max(y_ref.front(), y_ref.back()))) {
+                return x_input;
+            }
+            if (y_from == y_to) {
+                return find(x_input, y_from);
+            }
+            int from_cell = mean_cell(y_from);
+            int to_cell = mean_cell(y_to);
+            auto mean = [&](int i) {
+                return column_mean(i, from_cell, y_from, to_cell, y_to);
+            };
+
+            if (batch_order != SortOrder::Unsorted) {
+                // lut_bracket_sorted(), averaging only the probed columns
+                bool descending = (batch_order == SortOrder::Descending);
+                auto before = [&](double value) { return descending ? (value > x_input) : (value <= x_input); };
+                if (x_len < 2 || !before(mean(0))) {
+                    return x_input;
+                }
+                int first = 0;
+                int len = x_len;
+                while (len > 1) {
+                    int half = len / 2;
+                    first = before(mean(first + half)) ? first + half : first;
+                    len -= half;
+                }
+                if (first >= x_len - 1) {
+                    return x_input;
+                }
+                return linear_interpolate(mean(first), x_ref[first], mean(first + 1), x_ref[first + 1], x_input);
+            }
+
+            thread_local std::vector<double> mean_row;
+            mean_row.resize(x_len);
+            for (int i = 0; i < x_len; i++) {
+                mean_row[i] = mean(i);
+            }
+            int x_lower_idx = -1;
+            int x_upper_idx = -1;
+            if (!find_nearest_indexes(mean_row.data(), x_len, x_input, SortOrder::Unsorted, &x_lower_idx, &x_upper_idx)) {
+                return x_input;
+            }
+            return linear_interpolate(mean_row[x_lower_idx], x_ref[x_lower_idx], mean_row[x_upper_idx], x_ref[x_upper_idx], x_input);
+        }
+
+        /**
+         * @brief Provides read-only access to the y-reference values
+        */
+        const std::vector<double> getYRef() const {
+            return std::vector<double>(y_ref.begin(), y_ref.end());
+        }
+
+        /**
+         * @brief Provides read-only access to the x-reference values
+        */
+        const std::vector<double> getXRef() const {
+            return std::vector<double>(x_ref.begin(), x_ref.end());
+        }
+
+        /**
+         * @brief Provides read-only access to the table
+        */
+        const std::vector<double> operator[](size_t row) const {
+            if (row >= (size_t)y_len) {
+                throw std::out_of_range("Row index out of range");
+            }
+            return std::vector<double>(table.begin() + row * x_len, table.begin() + (row + 1) * x_len);
+        }
+
+        /**
+         * @brief Whether find() skips missing cells, i.e. the table was built with MissingCells::MaskPerQuery
+        */
+        bool hasMask() const {
+            return !valid.empty();
+        }
+
+        /**
+         * @brief Whether a cell holds data. Always true for tables without a mask.
+        */
+        bool isValid(size_t row, size_t column) const {
+            if (row >= (size_t)y_len || column >= (size_t)x_len) {
+                throw std::out_of_range("Cell index out of range");
+            }
+            return is_valid((int)row, (int)column);
+        }
+
+        /**
+         * @brief Direction the y-reference values are sorted in
+        */
+        SortOrder getYOrder() const {
+            return y_order;
+        }
+
+        /**
+         * @brief Direction a row of the table is sorted in
+        */
+        SortOrder getRowOrder(size_t row) const {
+            if (row >= (size_t)y_len) {
+                throw std::out_of_range("Row index out of range");
+            }
+            return row_order[row];
+        }
+
+        /**
+         * @brief Reads every cache line find() can touch once, so that they are in the calling core's caches
+         * @details For a thread that keeps to one core and keeps this table hot there, such as the
+         *      compensating stage of LUTPipeline. It does not change the table.
+        */
+        void prefetchTable() const {
+            auto touch = [](const void *data, size_t bytes) {
+                const volatile char *base = (const volatile char *)data;
+                for (size_t offset = 0; offset < bytes; offset += 64) {
+                    (void)base[offset];
+                }
+            };
+            touch(table.data(), table.size() * sizeof(StorageT));
+            touch(x_ref.data(), x_ref.size() * sizeof(StorageT));
+            touch(y_ref.data(), y_ref.size() * sizeof(StorageT));
+            touch(pair_table.data(), pair_table.size() * sizeof(ComputeT));
+            touch(valid.data(), valid.size() * sizeof(uint64_t));
+        }
+
+        /**
+         * @brief Bytes used by the table and reference lists
+        */
+        size_t memory_usage() const {
+            return (table.size() + x_ref.size() + y_ref.size()) * sizeof(StorageT) + valid.size() * sizeof(uint64_t) +
+                   pair_table.size() * sizeof(ComputeT) + y_integral.size() * sizeof(double);
+        }
+
+    private:
+        int x_len;  ///< Size of the table int the x-direction
+        int y_len;  ///< Size of the table int the y-direction
+        std::vector<StorageT> table; ///< Storage of the look-up table, row-major with y_len rows of x_len
+        std::vector<StorageT> x_ref;  ///< Interpolation reference values for the x-direction
+        std::vector<StorageT> y_ref;  ///< Interpolation reference values for the y-direction
+        SortOrder y_order;  ///< Direction of y_ref
+        std::vector<SortOrder> row_order;  ///< Direction of each row of the table
+        std::vector<SortOrder> pair_order;  ///< Direction of the blend of rows i and i+1
+        SortOrder batch_order;  ///< Direction shared by every pair_order entry, Unsorted if they differ
+        TableLayout layout = TableLayout::RowMajor;
+        std::vector<ComputeT> pair_table;   ///< Block of 2 * x_len per row pair for TableLayout::PairDelta, else empty
+        std::vector<double> y_integral;     ///< Integral of each column from y_ref[0] to each row, row-major, or empty
+        int mask_words = 0;  ///< 64-bit words per row of valid
+        uint64_t table_id = lut_next_table_id();  ///< See getTableId()
+        uint64_t version = 1;  ///< See getVersion()
+        LUTMetrics *metrics = nullptr;  ///< Where lookups are recorded, if anywhere
+        size_t row_cache_entries = 0;  ///< See setRowCache()
+        std::vector<uint64_t> valid;  ///< Bitset per row of the cells that hold data, empty if all do
+
+        /**
+         * @brief A column missing from both rows of a pair, with the nearest columns either side that are not
+        */
+        struct Gap {
+            int column;
+            int left;
+            int right;
+        };
+        std::vector<int> pair_first;  ///< First column present in either row of each pair
+        std::vector<int> pair_last;  ///< Last column present in either row of each pair
+        std::vector<int> gap_offsets;  ///< Start of each pair's gaps in gaps, plus an end marker
+        std::vector<Gap> gaps;  ///< Interior columns missing from both rows, pair after pair
+
+        /**
+         * @brief Everything but the identity, for copy construction and assignment
+        */
+        void copy_contents(const BasicInterpolableLUT &source) {
+            x_len = source.x_len;
+            y_len = source.y_len;
+            table = source.table;
+            x_ref = source.x_ref;
+            y_ref = source.y_ref;
+            y_order = source.y_order;
+            row_order = source.row_order;
+            pair_order = source.pair_order;
+            batch_order = source.batch_order;
+            layout = source.layout;
+            pair_table = source.pair_table;
+            y_integral = source.y_integral;
+            mask_words = source.mask_words;
+            version = source.version;
+            metrics = source.metrics;
+            row_cache_entries = source.row_cache_entries;
+            valid = source.valid;
+            pair_first = source.pair_first;
+            pair_last = source.pair_last;
+            gap_offsets = source.gap_offsets;
+            gaps = source.gaps;
+        }
+
+        /**
+         * @brief See transposed()
+        */
+        BasicInterpolableLUT(const BasicInterpolableLUT &source, LUTExecutor &executor)
+            :x_len(source.y_len), y_len(source.x_len), x_ref(source.y_ref), y_ref(source.x_ref) {
+            LUT_PROBE(table__load__entry, table_id, x_len, y_len);
+            table.resize((size_t)x_len * y_len);
+            lut_transpose(source.table.data(), (size_t)source.y_len, (size_t)source.x_len, table.data(), executor);
+            if (!source.valid.empty()) {
+                mask_words = (x_len + 63) / 64;
+                valid.assign((size_t)mask_words * y_len, 0);
+                for (int row = 0; row < y_len; row++) {
+                    for (int i = 0; i < x_len; i++) {
+                        if (source.is_valid(i, row)) {
+                            valid[(size_t)row * mask_words + (i >> 6)] |= (uint64_t)1 << (i & 63);
+                        }
+                    }
+                }
+                find_gaps();
+            }
+            detect_orders();
+            if (source.layout != TableLayout::RowMajor) {
+                setLayout(source.layout);
+            }
+            if (source.hasYIntegrals()) {
+                setYIntegrals(true);
+            }
+            row_cache_entries = source.row_cache_entries;
+            LUT_PROBE(table__load__return, table_id, x_len, y_len, (int)!this->valid.empty());
+        }
+
+        /**
+         * @brief Copies the rows back to back so that the two rows used by find() are contiguous runs
+         * @details Also validates the input. x_len and y_len must be at least 1, as ilut_create()
+         *      demands, and match the sizes of the lists and rows. The reference values must be
+         *      finite, as must every table value if check_values is set; anything else throws
+         *      std::invalid_argument. Each row is checked by lut_check_row() right
+         *      after it is copied, while it is still in cache, which also records y_order and
+         *      row_order for detect_pair_orders(). Large tables are loaded in ranges of rows on
+         *      the shared executor.
+        */
+        void load_table(const std::vector<std::vector<double>> (&rows), bool check_values) {
+            if (x_len < 1 || y_len < 1) {
+                throw std::invalid_argument("x_len and y_len must be at least 1");
+            }
+            if (x_ref.size() != (size_t)x_len || y_ref.size() != (size_t)y_len ||
+                rows.size() != (size_t)y_len) {
+                throw std::invalid_argument("x_len and y_len must match the reference lists and the rows of the table");
+            }
+            for (int row = 0; row < y_len; row++) {
+                if (rows[row].size() != (size_t)x_len) {
+                    throw std::invalid_argument("Every row of the table needs x_len values");
+                }
+            }
+            LUTRowCheck x_check = lut_check_row(x_ref.data(), x_len);
+            LUTRowCheck y_check = lut_check_row(y_ref.data(), y_len);
+            if (!x_check.finite || !y_check.finite) {
+                throw std::invalid_argument("Reference values must be finite");
+            }
+            y_order = y_check.order;
+
+            table.resize((size_t)x_len * y_len);
+            row_order.resize(y_len);
+            std::vector<char> row_finite(y_len);
+            auto load = [&](size_t begin, size_t end) {
+                for (size_t row = begin; row < end; row++) {
+                    StorageT *out = &table[row * x_len];
+                    const double *in = rows[row].data();
+                    for (int i = 0; i < x_len; i++) {
+                        out[i] = (StorageT)in[i];
+                    }
+                    LUTRowCheck check = lut_check_row(out, x_len);
+                    row_order[row] = check.order;
+                    row_finite[row] = check.finite;
+                }
+            };
+            if ((size_t)x_len * y_len < ((size_t)1 << 18)) {
+                load(0, y_len);
+            } else {
+                LUTExecutor::shared().parallel_for(y_len, std::max<size_t>(1, ((size_t)1 << 16) / std::max(1, x_len)), load);
+            }
+            if (check_values && std::find(row_finite.begin(), row_finite.end(), 0) != row_finite.end()) {
+                throw std::invalid_argument("Table values must be finite; mark missing cells with a mask instead");
+            }
+        }
+
+        bool is_valid(int row, int i) const {
+            return valid.empty() || ((valid[(size_t)row * mask_words + (i >> 6)] >> (i & 63)) & 1);
+        }
+
+        /**
+         * @brief Fills every missing cell from the valid cells of the same column
+         * @details Cells between two valid cells are either interpolated in y or copied from the
+         *      nearer one. Cells past the first or last valid cell always copy it. A column
+         *      with no valid cell at all cannot be filled and throws std::invalid_argument; such
+         *      tables need MissingCells::MaskPerQuery.
+        */
+        void fill_missing(bool interpolate) {
+            for (int i = 0; i < x_len; i++) {
+                bool any_valid = false;
+                for (int row = 0; row < y_len && !any_valid; row++) {
+                    any_valid = is_valid(row, i);
+                }
+                if (!any_valid) {
+                    throw std::invalid_argument("A column without any valid cell cannot be filled; use MissingCells::MaskPerQuery");
+                }
+            }
+            for (int i = 0; i < x_len; i++) {
+                int previous = -1;
+                for (int row = 0; row <= y_len; row++) {
+                    if (row < y_len && !is_valid(row, i)) {
+                        continue;
+                    }
+                    // Fill the run of missing cells between previous and row
+                    for (int gap = previous + 1; gap < row; gap++) {
+                        int source = (previous < 0) ? row : previous;
+                        if (row < y_len && previous >= 0) {
+                            double distance_previous = std::fabs((double)y_ref[gap] - (double)y_ref[previous]);
+                            double distance_next = std::fabs((double)y_ref[row] - (double)y_ref[gap]);
+                            if (interpolate) {
+                                table[(size_t)gap * x_len + i] = (StorageT)linear_interpolate(
+                                    y_ref[previous], table[(size_t)previous * x_len + i],
+                                    y_ref[row], table[(size_t)row * x_len + i], y_ref[gap]);
+                                continue;
+                            }
+                            source = (distance_next < distance_previous) ? row : previous;
+                        }
+                        if (source < y_len) {
+                            table[(size_t)gap * x_len + i] = table[(size_t)source * x_len + i];
+                        }
+                    }
+                    previous = row;
+                }
+            }
+        }
+
+        /**
+         * @brief Lists, for every pair of adjacent rows, the columns missing from both
+        */
+        void find_gaps() {
+            gap_offsets.assign(1, 0);
+            for (int row = 0; row < y_len - 1; row++) {
+                int first = x_len;
+                int last = -1;
+                for (int i = 0; i < x_len; i++) {
+                    if (is_valid(row, i) || is_valid(row + 1, i)) {
+                        first = std::min(first, i);
+                        last = i;
+                    }
+                }
+                int left = first;
+                for (int i = first + 1; i < last; i++) {
+                    if (is_valid(row, i) || is_valid(row + 1, i)) {
+                        left = i;
+                        continue;
+                    }
+                    int right = i + 1;
+                    while (!is_valid(row, right) && !is_valid(row + 1, right)) {
+                        right++;
+                    }
+                    gaps.push_back({ i, left, right });
+                }
+                pair_first.push_back(std::min(first, x_len - 1));
+                pair_last.push_back(last);
+                gap_offsets.push_back((int)gaps.size());
+            }
+        }
+
+        /**
+         * @brief Integral of column i over the cell between rows cell and cell + 1, in the direction of y_ref
+        */
+        double cell_integral(int i, int cell) const {
+            return 0.5 * ((double)y_ref[cell + 1] - y_ref[cell]) *
+                   ((double)table[(size_t)cell * x_len + i] + table[(size_t)(cell + 1) * x_len + i]);
+        }
+
+        /**
+         * @brief Cell holding y for findMean(), where both ends of y_ref belong to the cell next to them
+        */
+        int mean_cell(double y) const {
+            int above = (y_order == SortOrder::Descending)
+                ? (int)(std::upper_bound(y_ref.begin(), y_ref.end(), (StorageT)y, std::greater<StorageT>()) - y_ref.begin())
+                : (int)(std::upper_bound(y_ref.begin(), y_ref.end(), (StorageT)y) - y_ref.begin());
+            return std::min(std::max(above - 1, 0), y_len - 2);
+        }
+
+        /**
+         * @brief Mean of column i from y_from in cell from_cell to y_to in cell to_cell
+        */
+        double column_mean(int i, int from_cell, double y_from, int to_cell, double y_to) const {
+            auto from_row = [&](int cell, double y) {
+                double y0 = y_ref[cell];
+                double v0 = table[(size_t)cell * x_len + i];
+                double v1 = table[(size_t)(cell + 1) * x_len + i];
+                double v = v0 + (v1 - v0) * (y - y0) / ((double)y_ref[cell + 1] - y0);
+                return 0.5 * (y - y0) * (v0 + v);
+            };
+            double integral = from_row(to_cell, y_to) - from_row(from_cell, y_from);
+            if (!y_integral.empty()) {
+                integral += y_integral[(size_t)to_cell * x_len + i] - y_integral[(size_t)from_cell * x_len + i];
+            } else {
+                for (int cell = std::min(from_cell, to_cell); cell < std::max(from_cell, to_cell); cell++) {
+                    integral += (to_cell > from_cell) ? cell_integral(i, cell) : -cell_integral(i, cell);
+                }
+            }
+            return integral / (y_to - y_from);
+        }
+
+        /**
+         * @brief Records the direction of every list once so that find() never has to copy or negate
+        */
+        void detect_orders() {
+            y_order = lut_check_row(y_ref.data(), y_len).order;
+            row_order.resize(y_len);
+            for (int row = 0; row < y_len; row++) {
+                detect_row_order(row);
+            }
+            detect_pair_orders();
+        }
+
+        /**
+         * @brief The part of detect_orders() that follows from row_order, which picks the batch kernel
+        */
+        void detect_pair_orders() {
+            pair_order.resize(y_len > 0 ? y_len - 1 : 0);
+            for (int row = 0; row < y_len - 1; row++) {
+                detect_pair_order(row);
+            }
+            detect_batch_order();
+        }
+
+        void detect_row_order(int row) {
+            if (valid.empty()) {
+                row_order[row] = lut_check_row(&table[(size_t)row * x_len], x_len).order;
+                return;
+            }
+            // Missing cells do not take part in the search, so they do not count here either
+            thread_local std::vector<StorageT> present;
+            present.resize(x_len);
+            int count = 0;
+            for (int i = 0; i < x_len; i++) {
+                if (is_valid(row, i)) {
+                    present[count++] = table[(size_t)row * x_len + i];
+                }
+            }
+            row_order[row] = detect_sort_order(present.data(), count);
+        }
+
+        void detect_pair_order(int row) {
+            // A blend of two rows sorted the same way is sorted that way too, as long as both
+            // rows are missing the same cells
+            bool same_cells = valid.empty() ||
+                std::equal(&valid[(size_t)row * mask_words], &valid[(size_t)(row + 1) * mask_words],
+                           &valid[(size_t)(row + 1) * mask_words]);
+            if (same_cells || row_order[row] != row_order[row + 1]) {
+                pair_order[row] = (row_order[row] == row_order[row + 1]) ? row_order[row] : SortOrder::Unsorted;
+            } else {
+                pair_order[row] = detect_masked_pair_order(row);
+            }
+        }
+
+        void detect_batch_order() {
+            batch_order = pair_order.empty() ? SortOrder::Unsorted : pair_order[0];
+            for (SortOrder order : pair_order) {
+                batch_order = (order == batch_order) ? order : SortOrder::Unsorted;
+            }
+        }
+
+        /**
+         * @brief Direction of the blend of two rows that are missing different cells
+         * @details A blended column lies between the values the two rows have for it, so the
+         *      blend is sorted for any y if those ranges are sorted themselves, column after
+         *      present column.
+        */
+        SortOrder detect_masked_pair_order(int row) const {
+            bool ascending = true;
+            bool descending = true;
+            bool have_previous = false;
+            StorageT previous_low = 0;
+            StorageT previous_high = 0;
+            for (int i = 0; i < x_len; i++) {
+                bool lower_present = is_valid(row, i);
+                bool upper_present = is_valid(row + 1, i);
+                if (!lower_present && !upper_present) {
+                    continue;
+                }
+                StorageT a = table[(size_t)(lower_present ? row : row + 1) * x_len + i];
+                StorageT b = table[(size_t)(upper_present ? row + 1 : row) * x_len + i];
+                StorageT low = std::min(a, b);
+                StorageT high = std::max(a, b);
+                if (have_previous) {
+                    ascending &= (previous_high <= low);
+                    descending &= (previous_low >= high);
+                }
+                have_previous = true;
+                previous_low = low;
+                previous_high = high;
+            }
+            if (ascending) {
+                return SortOrder::Ascending;
+            }
+            return descending ? SortOrder::Descending : SortOrder::Unsorted;
+        }
+
+        /**
+         * @brief find() that feeds metrics and the tracer
+         * @details tracing is the LUTTracer::enabled() that find() already read. Reading it again
+         *      here could see tracing switched off by another thread with no recorder to feed.
+        */
+        double find_observed(double x_input, double y_input, ComputeT *interpolated_y_values_at_x, LUTMetrics *recorder,
+                             bool tracing) {
+            bool sampled = (recorder != nullptr) && recorder->sampleLatency();
+            LookupInfo info;
+            if (!tracing && !sampled) {
+                double result = find(x_input, y_input, interpolated_y_values_at_x, &info);
+                if (recorder != nullptr) {
+                    recorder->record(info.outcome);
+                }
+                return result;
+            }
+
+            uint64_t start = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch()).count();
+            double result = find(x_input, y_input, interpolated_y_values_at_x, &info);
+            uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch()).count() - start;
+            if (recorder != nullptr) {
+                if (sampled) {
+                    recorder->record(info.outcome, elapsed);
+                } else {
+                    recorder->record(info.outcome);
+                }
+            }
+            if (tracing) {
+                LUTTracer::record({ start, table_id, x_input, y_input, result, info.y_lower_idx, info.x_lower_idx,
+                                    (uint32_t)std::min<uint64_t>(elapsed, UINT32_MAX), (uint8_t)info.outcome,
+                                    (uint8_t)info.kernel, (uint8_t)info.x_search, 0 });
+            }
+            return result;
+        }
+
+        /**
+         * @brief find() with a caller provided scratch area of at least 2 * x_len elements
+         * @details info, if given, receives how the lookup went
+        */
+        double find(double x_input, double y_input, ComputeT *interpolated_y_values_at_x, LookupInfo *info) {
+            int x_lower_idx = -1;
+            int x_upper_idx = -1;
+            int y_lower_idx = -1;
+            int y_upper_idx = -1;
+            double result = (double)x_input;
+            LookupOutcome outcome = LookupOutcome::YOutOfRange;
+            LookupKernel kernel = LookupKernel::None;
+            LUT_PROBE(find__entry, table_id, lut_probe_bits(x_input), lut_probe_bits(y_input));
+
+            if (find_nearest_indexes(y_ref.data(), y_len, (ComputeT)y_input, y_order, &y_lower_idx, &y_upper_idx)) {
+                outcome = LookupOutcome::XOutOfRange;
+                const ComputeT *row = interpolated_y_values_at_x;
+                if (row_cache_entries == 0) {
+                    kernel = blend(y_input, y_lower_idx, y_upper_idx, interpolated_y_values_at_x);
+                } else {
+                    row = cached_row(y_input, y_lower_idx, y_upper_idx, &kernel);
+                }
+
+                // Columns before the first or after the last present one of a masked table are
+                // left out of the search.
+                int first = valid.empty() ? 0 : pair_first[y_lower_idx];
+                int present = valid.empty() ? x_len : pair_last[y_lower_idx] - first + 1;
+                if (find_nearest_indexes(row + first, present, (ComputeT)x_input, pair_order[y_lower_idx],
+                                         &x_lower_idx, &x_upper_idx)) {
+                    outcome = LookupOutcome::Interpolated;
+                    x_lower_idx += first;
+                    x_upper_idx += first;
+                    result = linear_interpolate(row[x_lower_idx], x_ref[x_lower_idx], row[x_upper_idx], x_ref[x_upper_idx],
+                                                x_input);
+                }
+            }
+
+            if (info != nullptr) {
+                info->outcome = outcome;
+                info->kernel = kernel;
+                info->x_search = (y_lower_idx >= 0) ? pair_order[y_lower_idx] : SortOrder::Unsorted;
+                info->y_lower_idx = y_lower_idx;
+                info->x_lower_idx = x_lower_idx;
+            }
+            LUT_PROBE(find__return, table_id, (int)outcome, y_lower_idx, x_lower_idx, lut_probe_bits(result));
+            return result;
+        }
+
+        /**
+         * @brief Blends the rows around y_input into out, the row find() searches
+         * @return The kernel that did it
+        */
+        LookupKernel blend(double y_input, int y_lower_idx, int y_upper_idx, ComputeT *out) {
+            // Interpolate the pH values at the measured temperature for each buffer.
+            ComputeT y0 = y_ref[y_lower_idx];
+            ComputeT y1 = y_ref[y_upper_idx];
+            ComputeT t = ((ComputeT)y_input - y0) / (y1 - y0);
+
+            if (valid.empty()) {
+                if (!pair_table.empty() && y_upper_idx == y_lower_idx + 1) {
+                    const ComputeT *pair = &pair_table[2 * (size_t)y_lower_idx * x_len];
+                    lut_blend_delta(pair, pair + x_len, t, out, x_len);
+                    return LookupKernel::PairDelta;
+                }
+                lut_blend_rows(&table[(size_t)y_lower_idx * x_len], &table[(size_t)y_upper_idx * x_len], t, out, x_len);
+                return LookupKernel::Dense;
+            }
+
+            lut_blend_rows_masked(&table[(size_t)y_lower_idx * x_len], &table[(size_t)y_upper_idx * x_len],
+                                  &valid[(size_t)y_lower_idx * mask_words], &valid[(size_t)y_upper_idx * mask_words],
+                                  t, out, x_len);
+            // A column missing from both rows is put on the line between its present
+            // neighbours, which searches the same as skipping it.
+            for (int g = gap_offsets[y_lower_idx]; g < gap_offsets[y_lower_idx + 1]; g++) {
+                const Gap &gap = gaps[g];
+                out[gap.column] = linear_interpolate(x_ref[gap.left], out[gap.left], x_ref[gap.right], out[gap.right],
+                                                     x_ref[gap.column]);
+            }
+            return LookupKernel::Masked;
+        }
+
+        /**
+         * @brief Blended row of the thread's row cache, see setRowCache()
+        */
+        struct CachedRow {
+            const BasicInterpolableLUT *owner;
+            uint64_t table_id;
+            uint64_t version;
+            TableLayout layout;
+            double y_input;
+            uint64_t last_used;
+            std::vector<ComputeT> values;
+        };
+
+        /**
+         * @brief The row blended at y_input, from the thread's row cache, blending it on a miss
+         * @details kernel receives LookupKernel::RowCache on a hit, the blending kernel otherwise.
+         *      The row stays valid until the next lookup on this thread.
+        */
+        const ComputeT *cached_row(double y_input, int y_lower_idx, int y_upper_idx, LookupKernel *kernel) {
+            thread_local std::vector<CachedRow> rows;
+            thread_local uint64_t uses = 0;
+            uses++;
+            CachedRow *victim = nullptr;
+            for (CachedRow &entry : rows) {
+                if (entry.y_input == y_input && entry.owner == this && entry.table_id == table_id &&
+                    entry.version == version && entry.layout == layout) {
+                    entry.last_used = uses;
+                    *kernel = LookupKernel::RowCache;
+                    if (metrics != nullptr) {
+                        metrics->recordCache(true);
+                    }
+                    return entry.values.data();
+                }
+                if (victim == nullptr || entry.last_used < victim->last_used) {
+                    victim = &entry;
+                }
+            }
+            if (metrics != nullptr) {
+                metrics->recordCache(false);
+            }
+
+            if (rows.size() < row_cache_entries) {
+                rows.push_back(CachedRow());
+                victim = &rows.back();
+            }
+            victim->owner = this;
+            victim->table_id = table_id;
+            victim->version = version;
+            victim->layout = layout;
+            victim->y_input = y_input;
+            victim->last_used = uses;
+            if (victim->values.size() < (size_t)x_len) {
+                victim->values.resize(x_len);
+            }
+            *kernel = blend(y_input, y_lower_idx, y_upper_idx, victim->values.data());
+            return victim->values.data();
+        }
+
+#if defined(__AVX2__)
+        /**
+         * @brief Lane-wise lut_bracket_sorted() comparison, all ones where value is on the same side of search_val as list[0]
+        */
+        template <bool Descending>
+        static __m256d gather_side(__m256d value, __m256d search_val) {
+            return Descending ? _mm256_cmp_pd(value, search_val, _CMP_GT_OQ) : _mm256_cmp_pd(value, search_val, _CMP_LE_OQ);
+        }
+
+        /**
+         * @brief find_batch() for whole groups of 4 queries
+         * @details Follows find() step by step so that every lane computes the same values
+         * @return Number of queries done
+        */
+        template <bool YDescending, bool XDescending>
+        size_t find_batch_gather(const double *x_input, const double *y_input, double *out, size_t len) {
+            const StorageT *cells = table.data();
+            const __m256i x_stride = _mm256_set1_epi64x(x_len);
+            const __m256i one = _mm256_set1_epi64x(1);
+            const __m256i y_last = _mm256_set1_epi64x(y_len - 1);
+            const __m256i x_last = _mm256_set1_epi64x(x_len - 1);
+            const __m256d y_first = _mm256_set1_pd((double)y_ref[0]);
+            size_t i = 0;
+            for (; i + 4 <= len; i += 4) {
+                __m256d x = _mm256_loadu_pd(x_input + i);
+                __m256d y = _mm256_loadu_pd(y_input + i);
+
+                // y bracket, as lut_bracket_sorted() on y_ref
+                __m256d in_range = gather_side<YDescending>(y_first, y);
+                __m256i y_lower = _mm256_setzero_si256();
+                for (int span = y_len; span > 1; ) {
+                    int half = span / 2;
+                    __m256i probe = _mm256_add_epi64(y_lower, _mm256_set1_epi64x(half));
+                    __m256d side = gather_side<YDescending>(lut_gather4(y_ref.data(), probe), y);
+                    y_lower = _mm256_add_epi64(y_lower, _mm256_and_si256(_mm256_castpd_si256(side), _mm256_set1_epi64x(half)));
+                    span -= half;
+                }
+                in_range = _mm256_and_pd(in_range, _mm256_castsi256_pd(_mm256_cmpgt_epi64(y_last, y_lower)));
+                // Lanes out of range keep computing on a valid pair and are replaced at the end
+                y_lower = _mm256_and_si256(y_lower, _mm256_castpd_si256(in_range));
+
+                __m256d y0 = lut_gather4(y_ref.data(), y_lower);
+                __m256d y1 = lut_gather4(y_ref.data(), _mm256_add_epi64(y_lower, one));
+                __m256d t = _mm256_div_pd(_mm256_sub_pd(y, y0), _mm256_sub_pd(y1, y0));
+                __m256i lower_row = _mm256_mul_epu32(y_lower, x_stride);
+                __m256i upper_row = _mm256_add_epi64(lower_row, x_stride);
+
+                // x bracket, as lut_bracket_sorted() on the blended row, blending only the probed cells
+                auto blended = [&](__m256i column) {
+                    __m256d lo = lut_gather4(cells, _mm256_add_epi64(lower_row, column));
+                    __m256d hi = lut_gather4(cells, _mm256_add_epi64(upper_row, column));
+#if defined(__FMA__)
+                    return _mm256_fmadd_pd(_mm256_sub_pd(hi, lo), t, lo);
+#else
+                    return _mm256_add_pd(lo, _mm256_mul_pd(_mm256_sub_pd(hi, lo), t));
+#endif
+                };
+                __m256i x_lower = _mm256_setzero_si256();
+                in_range = _mm256_and_pd(in_range, gather_side<XDescending>(blended(x_lower), x));
+                for (int span = x_len; span > 1; ) {
+                    int half = span / 2;
+                    __m256d side = gather_side<XDescending>(blended(_mm256_add_epi64(x_lower, _mm256_set1_epi64x(half))), x);
+                    x_lower = _mm256_add_epi64(x_lower, _mm256_and_si256(_mm256_castpd_si256(side), _mm256_set1_epi64x(half)));
+                    span -= half;
+                }
+                in_range = _mm256_and_pd(in_range, _mm256_castsi256_pd(_mm256_cmpgt_epi64(x_last, x_lower)));
+                x_lower = _mm256_and_si256(x_lower, _mm256_castpd_si256(in_range));
+
+                // Corner cells of the bracket, as linear_interpolate()
+                __m256i x_upper = _mm256_add_epi64(x_lower, one);
+                __m256d v0 = blended(x_lower);
+                __m256d v1 = blended(x_upper);
+                __m256d r0 = lut_gather4(x_ref.data(), x_lower);
+                __m256d r1 = lut_gather4(x_ref.data(), x_upper);
+                __m256d result = _mm256_add_pd(r0, _mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(r1, r0), _mm256_sub_pd(x, v0)),
+                                                                 _mm256_sub_pd(v1, v0)));
+                _mm256_storeu_pd(out + i, _mm256_blendv_pd(x, result, in_range));
+            }
+            return i;
+        }
+#endif
+
+        /**
+         * @brief Find the two indexes in the list where the search_val would fall in between
+         * @details Sorted lists use a binary search in their own direction, unsorted lists fall
+         *      back to a scan for the first pair that brackets search_val in either direction.
+         * @return Indexes via pointers lower_result and upper_result
+         *         true if the search was successful, false if the search value is out of range of the list
+        */
+        template <typename T, typename V>
+        bool find_nearest_indexes(const T *list, int list_len, V search_val, SortOrder order, int *lower_result, int *upper_result) {
+            if (order == SortOrder::Ascending) {
+                return lut_bracket_sorted<false>(list, list_len, search_val, lower_result, upper_result);
+            }
+            if (order == SortOrder::Descending) {
+                return lut_bracket_sorted<true>(list, list_len, search_val, lower_result, upper_result);
+            }
+            bool ret = false;
+            for (int i = 0; i < list_len-1; i++) {
+                if (((list[i] <= search_val) && (list[i+1] > search_val)) ||
+                    ((list[i] > search_val) && (list[i+1] <= search_val))) {
+                    *lower_result = i;
+                    *upper_result = i + 1;
+                    ret = true;
+                    break;
+                }
+            }
+            return ret;
+        }
+
+        // This function performs linear interpolation between two points.
+        double linear_interpolate(double x0, double y0, double x1, double y1, double x) {
+            return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+        }
+};
+
+typedef BasicInterpolableLUT<double> InterpolableLUT;               ///< double storage, double math
+typedef BasicInterpolableLUT<float> InterpolableLUTf;               ///< float storage, float math
+typedef BasicInterpolableLUT<float, double> InterpolableLUTMixed;   ///< float storage, double math
+
+/**
+ * @brief One batch of queries against one table, for lut_find_batches()
+*/
+template <typename LUT>
+struct LUTBatch {
+    LUT *lut;
+    const double *x_input;
+    const double *y_input;
+    double *out;
+    size_t len;
+};
+
+/**
+ * @brief Runs several batches, possibly against tables of very different sizes, on one executor
+ * @details Each batch is split further with find_batch_parallel(), so idle workers steal ranges
+ *      of the expensive batches instead of waiting for the thread that started them.
+*/
+template <typename LUT>
+void lut_find_batches(const std::vector<LUTBatch<LUT>> &batches, LUTExecutor &executor = LUTExecutor::shared(),
+                      size_t grain = 1024) {
+    executor.parallel_for(batches.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; b++) {
+            const LUTBatch<LUT> &batch = batches[b];
+            batch.lut->find_batch_parallel(batch.x_input, batch.y_input, batch.out, batch.len, executor, grain);
+        }
+    });
+}
+
+template <typename StorageT, typename ComputeT>
+std::ostream& operator<<(std::ostream& os, const BasicInterpolableLUT<StorageT, ComputeT> &table) {
+    const std::vector<double> y_ref = table.getYRef();
+    for (size_t i = 0; i < y_ref.size(); i++) {
+        os << std::fixed << std::setprecision(2) << y_ref[i] << "\t";
+        const std::vector<double> row = table[i];
+        for (size_t j = 0; j < row.size(); j++) {
+            os << std::fixed << std::setprecision(2) << row[j] << "\t";
+        }
+        os << "\n";
+    }
+    return os;
+}
+
+/******************************************************************************
+                Interpolation error map for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief How InterpolationErrorMap estimates the error of linear interpolation
+*/
+enum class ErrorEstimate {
+    Curvature,          ///< h^2 / 8 * |second derivative|, with derivatives from neighbouring cells
+    CrossValidation     ///< Error of predicting each interior row and column from its neighbours
+};
+
+/**
+ * @brief A row or column that InterpolationErrorMap suggests adding or dropping
+*/
+struct RefinementSuggestion {
+    bool row;           ///< true for a y-reference row, false for an x-reference column
+    double position;    ///< y or x reference value to measure at, or of the line to drop
+    double error;       ///< Estimated error there now when adding, or introduced when dropping
+    long bytes;         ///< Change in memory usage, negative when dropping
+};
+
+/**
+ * @brief Estimates the error of linear interpolation for every cell of an InterpolableLUT and
+ *      advises where calibration points should be added or can be dropped
+ * @details Errors are in the units of the output of find(). A raw table error is divided by the
+ *      slope of the row, since that is how much the inverse search moves the result. Cells
+ *      next to a missing cell of a masked table use whichever neighbours are present.
+ *
+ *      The map is computed in parallel, one table row per task.
+*/
+class InterpolationErrorMap {
+
+    public:
+        template <typename StorageT, typename ComputeT>
+        InterpolationErrorMap(const BasicInterpolableLUT<StorageT, ComputeT> &lut, ErrorEstimate method):method(method) {
+            x_ref = lut.getXRef();
+            y_ref = lut.getYRef();
+            x_len = (int)x_ref.size();
+            y_len = (int)y_ref.size();
+            cell_bytes = sizeof(StorageT);
+            table.resize((size_t)x_len * y_len);
+            present.resize((size_t)x_len * y_len);
+            for (int row = 0; row < y_len; row++) {
+                const std::vector<double> values = lut[row];
+                for (int i = 0; i < x_len; i++) {
+                    table[(size_t)row * x_len + i] = values[i];
+                    present[(size_t)row * x_len + i] = lut.isValid(row, i);
+                }
+            }
+
+            row_drop_error.assign(y_len, 0);
+            column_drop_error.assign(x_len, 0);
+            node_error.assign((size_t)x_len * y_len, 0);
+            lut_parallel_for(y_len, [this](size_t row) { estimate_row((int)row); });
+
+            cell_error.assign((size_t)std::max(0, x_len - 1) * std::max(0, y_len - 1), 0);
+            lut_parallel_for(std::max(0, y_len - 1), [this](size_t row) { combine_cells((int)row); });
+
+            // Dropping a line costs the largest leave-one-out error along it
+            for (int row = 0; row < y_len; row++) {
+                for (int i = 0; i < x_len; i++) {
+                    row_drop_error[row] = std::max(row_drop_error[row], leave_one_out(row, i, true));
+                    column_drop_error[i] = std::max(column_drop_error[i], leave_one_out(row, i, false));
+                }
+            }
+        }
+
+        /**
+         * @brief Estimated largest error inside the cell between rows row, row+1 and columns column, column+1
+        */
+        double error(int row, int column) const {
+            if (row < 0 || column < 0 || row >= y_len - 1 || column >= x_len - 1) {
+                throw std::out_of_range("Cell index out of range");
+            }
+            return cell_error[(size_t)row * (x_len - 1) + column];
+        }
+
+        /**
+         * @brief Ranked suggestions that bring the table towards the target error within a memory budget
+         * @details Interior rows and columns whose removal would stay below target_error are dropped
+         *      first, cheapest first and never two neighbours. Then the midpoints of the rows and columns
+         *      of cells above target_error are added, worst first, while the table still fits in
+         *      memory_budget bytes. If the table is over budget, lines are dropped until it fits even if
+         *      that exceeds target_error.
+        */
+        std::vector<RefinementSuggestion> advise(double target_error, size_t memory_budget) const {
+            std::vector<RefinementSuggestion> drops;
+            for (int row = 1; row < y_len - 1; row++) {
+                drops.push_back({ true, y_ref[row], row_drop_error[row], -(long)((x_len + 1) * cell_bytes) });
+            }
+            for (int i = 1; i < x_len - 1; i++) {
+                drops.push_back({ false, x_ref[i], column_drop_error[i], -(long)((y_len + 1) * cell_bytes) });
+            }
+            std::sort(drops.begin(), drops.end(), [](const RefinementSuggestion &a, const RefinementSuggestion &b) {
+                return a.error < b.error;
+            });
+
+            std::vector<RefinementSuggestion> adds;
+            for (int row = 0; row < y_len - 1; row++) {
+                double worst = 0;
+                for (int i = 0; i < x_len - 1; i++) {
+                    worst = std::max(worst, error(row, i));
+                }
+                adds.push_back({ true, (y_ref[row] + y_ref[row + 1]) / 2, worst, (long)((x_len + 1) * cell_bytes) });
+            }
+            for (int i = 0; i < x_len - 1; i++) {
+                double worst = 0;
+                for (int row = 0; row < y_len - 1; row++) {
+                    worst = std::max(worst, error(row, i));
+                }
+                adds.push_back({ false, (x_ref[i] + x_ref[i + 1]) / 2, worst, (long)((y_len + 1) * cell_bytes) });
+            }
+            std::sort(adds.begin(), adds.end(), [](const RefinementSuggestion &a, const RefinementSuggestion &b) {
+                return a.error > b.error;
+            });
+
+            std::vector<RefinementSuggestion> advice;
+            long usage = (long)(((size_t)x_len * y_len + x_len + y_len) * cell_bytes);
+            std::vector<char> row_dropped(y_len, 0), column_dropped(x_len, 0);
+            for (const RefinementSuggestion &drop : drops) {
+                if (drop.error >= target_error && usage <= (long)memory_budget) {
+                    break;
+                }
+                std::vector<char> &dropped = drop.row ? row_dropped : column_dropped;
+                const std::vector<double> &axis = drop.row ? y_ref : x_ref;
+                int index = (int)(std::find(axis.begin(), axis.end(), drop.position) - axis.begin());
+                if (dropped[index - 1] || dropped[index + 1]) {
+                    continue;
+                }
+                dropped[index] = 1;
+                usage += drop.bytes;
+                advice.push_back(drop);
+            }
+            for (const RefinementSuggestion &add : adds) {
+                if (add.error <= target_error) {
+                    break;
+                }
+                if (usage + add.bytes <= (long)memory_budget) {
+                    usage += add.bytes;
+                    advice.push_back(add);
+                }
+            }
+            return advice;
+        }
+
+        int getXLen() const { return x_len; }
+        int getYLen() const { return y_len; }
+        const std::vector<double> &getXRef() const { return x_ref; }
+        const std::vector<double> &getYRef() const { return y_ref; }
+
+    private:
+        ErrorEstimate method;
+        int x_len;
+        int y_len;
+        size_t cell_bytes;  ///< Bytes per stored value of the table the map was made for
+        std::vector<double> x_ref;
+        std::vector<double> y_ref;
+        std::vector<double> table;  ///< Copy of the table, row-major
+        std::vector<char> present;  ///< Whether each cell of table holds data
+        std::vector<double> node_error;  ///< Error estimate at every node, row-major
+        std::vector<double> cell_error;  ///< Error estimate of every cell, (y_len - 1) rows of x_len - 1
+        std::vector<double> row_drop_error;  ///< Largest error at a row if it was removed
+        std::vector<double> column_drop_error;  ///< Largest error at a column if it was removed
+
+        double value(int row, int i) const {
+            return table[(size_t)row * x_len + i];
+        }
+
+        bool has(int row, int i) const {
+            return row >= 0 && i >= 0 && row < y_len && i < x_len && present[(size_t)row * x_len + i];
+        }
+
+        /**
+         * @brief |d table / d x_ref| at a node, used to turn raw table errors into output errors
+        */
+        double slope(int row, int i) const {
+            int lower = has(row, i - 1) ? i - 1 : i;
+            int upper = has(row, i + 1) ? i + 1 : i;
+            if (lower == upper || x_ref[upper] == x_ref[lower]) {
+                return 1.0;
+            }
+            double s = std::fabs((value(row, upper) - value(row, lower)) / (x_ref[upper] - x_ref[lower]));
+            return (s > 0) ? s : 1.0;
+        }
+
+        /**
+         * @brief Second divided difference through three points, 0 if any is missing
+        */
+        static double second_difference(double p0, double v0, double p1, double v1, double p2, double v2) {
+            double h0 = p1 - p0;
+            double h1 = p2 - p1;
+            if (h0 == 0 || h1 == 0) {
+                return 0;
+            }
+            return 2.0 * ((v2 - v1) / h1 - (v1 - v0) / h0) / (h0 + h1);
+        }
+
+        /**
+         * @brief Error of predicting a node from its two neighbours along one axis, in output units
+        */
+        double leave_one_out(int row, int i, bool along_y) const {
+            int dr = along_y ? 1 : 0;
+            int di = along_y ? 0 : 1;
+            if (!has(row, i) || !has(row - dr, i - di) || !has(row + dr, i + di)) {
+                return 0;
+            }
+            const std::vector<double> &axis = along_y ? y_ref : x_ref;
+            int k = along_y ? row : i;
+            double predicted = value(row - dr, i - di) + (value(row + dr, i + di) - value(row - dr, i - di)) *
+                               (axis[k] - axis[k - 1]) / (axis[k + 1] - axis[k - 1]);
+            return std::fabs(predicted - value(row, i)) / slope(row, i);
+        }
+
+        /**
+         * @brief Fills node_error for one row
+        */
+        void estimate_row(int row) {
+            for (int i = 0; i < x_len; i++) {
+                double estimate = 0;
+                if (method == ErrorEstimate::Curvature) {
+                    // Curvature along each axis, from the nearest complete three-point stencil
+                    double curvature_y = 0;
+                    double curvature_x = 0;
+                    for (int centre = std::max(1, row - 1); centre <= std::min(y_len - 2, row + 1); centre++) {
+                        if (has(centre - 1, i) && has(centre, i) && has(centre + 1, i)) {
+                            curvature_y = std::max(curvature_y, std::fabs(second_difference(
+                                y_ref[centre - 1], value(centre - 1, i), y_ref[centre], value(centre, i), y_ref[centre + 1], value(centre + 1, i))));
+                        }
+                    }
+                    for (int centre = std::max(1, i - 1); centre <= std::min(x_len - 2, i + 1); centre++) {
+                        if (has(row, centre - 1) && has(row, centre) && has(row, centre + 1)) {
+                            curvature_x = std::max(curvature_x, std::fabs(second_difference(
+                                x_ref[centre - 1], value(row, centre - 1), x_ref[centre], value(row, centre), x_ref[centre + 1], value(row, centre + 1))));
+                        }
+                    }
+                    double hy = std::max(row > 0 ? std::fabs(y_ref[row] - y_ref[row - 1]) : 0.0,
+                                         row < y_len - 1 ? std::fabs(y_ref[row + 1] - y_ref[row]) : 0.0);
+                    double hx = std::max(i > 0 ? std::fabs(x_ref[i] - x_ref[i - 1]) : 0.0,
+                                         i < x_len - 1 ? std::fabs(x_ref[i + 1] - x_ref[i]) : 0.0);
+                    estimate = (hy * hy * curvature_y + hx * hx * curvature_x) / 8.0 / slope(row, i);
+                } else {
+                    // Leaving a node out doubles the spacing around it, which quadruples the error
+                    estimate = std::max(leave_one_out(row, i, true), leave_one_out(row, i, false)) / 4.0;
+                }
+                node_error[(size_t)row * x_len + i] = estimate;
+            }
+        }
+
+        /**
+         * @brief A cell's error is the largest error at its four corners
+        */
+        void combine_cells(int row) {
+            for (int i = 0; i < x_len - 1; i++) {
+                cell_error[(size_t)row * (x_len - 1) + i] = std::max(
+                    std::max(node_error[(size_t)row * x_len + i], node_error[(size_t)row * x_len + i + 1]),
+                    std::max(node_error[(size_t)(row + 1) * x_len + i], node_error[(size_t)(row + 1) * x_len + i + 1]));
+            }
+        }
+};
+
+/**
+ * @brief Writes the error map in the same layout as the table, one cell per column
+*/
+std::ostream& operator<<(std::ostream& os, const InterpolationErrorMap &map) {
+    for (int row = 0; row < map.getYLen() - 1; row++) {
+        os << std::fixed << std::setprecision(2) << map.getYRef()[row] << "\t";
+        for (int i = 0; i < map.getXLen() - 1; i++) {
+            os << std::scientific << std::setprecision(1) << map.error(row, i) << "\t";
+        }
+        os << "\n";
+    }
+    return os;
+}
+
+/******************************************************************************
+                Model plus residual for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Compensation by an analytic model with a small table for what the model misses
+ * @details Most of the temperature dependence of pH readings is a slope change around an
+ *      isothermal point, which the model
+ *
+ *          value(y, x) = x + (slope * x - offset) * (y - reference_y)
+ *
+ *      captures in closed form, with x the value at the reference y (the x-reference value of a
+ *      table). slope and offset are fitted to the table by least squares, and the isothermal
+ *      point is offset / slope. Only the residual, table minus model, is stored, on a coarse
+ *      grid that is interpolated bilinearly. When the grid's nodes are a subset of the table's
+ *      reference values, the result equals the table's at every node it kept.
+ *
+ *      find() solves value(y, x) + residual(y, x) = x_input for x exactly. At a fixed y both
+ *      terms are linear in x within a residual cell, so the equation is solved in closed form
+ *      on the cell of the model-only solution, and again on a neighbouring cell until the
+ *      solution lies in the cell it was solved on, which takes one or two cells in practice.
+ *      Like InterpolableLUT, the upper end of each axis counts as out of range.
+*/
+class ModelResidualLUT {
+
+    public:
+        /**
+         * @brief Fits the model to a table and samples its residual on a uniform residual_x_len by residual_y_len grid
+        */
+        template <typename LUT>
+        ModelResidualLUT(LUT &lut, int residual_x_len, int residual_y_len) {
+            if (residual_x_len < 2 || residual_y_len < 2) {
+                throw std::invalid_argument("The residual grid needs at least 2 points per axis");
+            }
+            load_table(lut);
+            fit_model();
+            sample_residual(uniform_nodes(x_ref, residual_x_len), uniform_nodes(y_ref, residual_y_len));
+            release_table();
+        }
+
+        /**
+         * @brief The smallest residual grid that keeps find() within tolerance of lut.find()
+         * @details Uniform grids up to the size of the table are tried, smallest first, with
+         *      axis lengths growing by about a quarter each step. Tables of up to 32 points per
+         *      axis are also thinned out one row or column at a time, starting from all of their
+         *      own reference values, which reproduce the table exactly. The smaller grid wins. If
+         *      nothing is close enough, the most accurate grid is returned.
+        */
+        template <typename LUT>
+        static ModelResidualLUT fit(LUT &lut, double tolerance) {
+            ModelResidualLUT model;
+            model.load_table(lut);
+            model.fit_model();
+
+            auto lengths = [](size_t table_len) {
+                std::vector<int> result;
+                for (int len = 2; len < (int)table_len; len = std::max(len + 1, len * 5 / 4)) {
+                    result.push_back(len);
+                }
+                result.push_back(std::max(2, (int)table_len));
+                return result;
+            };
+            std::vector<std::pair<int, int>> sizes;
+            for (int nx : lengths(model.x_ref.size())) {
+                for (int ny : lengths(model.y_ref.size())) {
+                    sizes.push_back({ nx, ny });
+                }
+            }
+            std::stable_sort(sizes.begin(), sizes.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+                return a.first * a.second < b.first * b.second;
+            });
+
+            std::vector<double> best_x;
+            std::vector<double> best_y;
+            double best_error = std::numeric_limits<double>::infinity();
+            auto consider = [&](const std::vector<double> &x_nodes, const std::vector<double> &y_nodes) {
+                model.sample_residual(x_nodes, y_nodes);
+                double error = model.max_error(lut);
+                bool accurate = error <= tolerance;
+                bool smaller = x_nodes.size() * y_nodes.size() < best_x.size() * best_y.size();
+                if ((accurate && (best_error > tolerance || smaller)) || (best_error > tolerance && error < best_error)) {
+                    best_x = x_nodes;
+                    best_y = y_nodes;
+                    best_error = error;
+                }
+                return accurate;
+            };
+            for (const std::pair<int, int> &size : sizes) {
+                if (consider(uniform_nodes(model.x_ref, size.first), uniform_nodes(model.y_ref, size.second))) {
+                    break;
+                }
+            }
+
+            if (model.x_ref.size() <= 32 && model.y_ref.size() <= 32) {
+                std::vector<double> x_nodes = model.x_ref;
+                std::vector<double> y_nodes = model.y_ref;
+                if (consider(x_nodes, y_nodes)) {
+                    // Drop whichever inner node keeps the error lowest, while it stays within tolerance
+                    while (true) {
+                        double lowest = std::numeric_limits<double>::infinity();
+                        int drop_axis = -1;
+                        size_t drop_index = 0;
+                        for (int axis = 0; axis < 2; axis++) {
+                            std::vector<double> &nodes = axis ? y_nodes : x_nodes;
+                            for (size_t i = 1; i + 1 < nodes.size(); i++) {
+                                std::vector<double> fewer = nodes;
+                                fewer.erase(fewer.begin() + i);
+                                model.sample_residual(axis ? x_nodes : fewer, axis ? fewer : y_nodes);
+                                double error = model.max_error(lut);
+                                if (error <= tolerance && error < lowest) {
+                                    lowest = error;
+                                    drop_axis = axis;
+                                    drop_index = i;
+                                }
+                            }
+                        }
+                        if (drop_axis < 0) {
+                            break;
+                        }
+                        std::vector<double> &nodes = drop_axis ? y_nodes : x_nodes;
+                        nodes.erase(nodes.begin() + drop_index);
+                    }
+                    consider(x_nodes, y_nodes);
+                }
+            }
+
+            model.sample_residual(best_x, best_y);
+            model.release_table();
+            return model;
+        }
+
+        /**
+         * @brief Calculates the standardized value for x_input, like InterpolableLUT::find()
+         * @return The standardized value, or x_input if it is out of range of the table or no
+         *      single x gives x_input
+        */
+        double find(double x_input, double y_input) const {
+            if (!(y_input >= y_nodes.front() && y_input < y_nodes.back())) {
+                return x_input;
+            }
+            double dy = y_input - reference_y;
+            double gain = 1.0 + slope * dy;
+            int j = cell(y_nodes, y_input);
+            double v = (y_input - y_nodes[j]) / (y_nodes[j + 1] - y_nodes[j]);
+            const double *lower = &residuals[(size_t)j * x_nodes.size()];
+            const double *upper = lower + x_nodes.size();
+
+            // Start on the residual cell of the model-only solution, then move towards the
+            // cell the solution falls in. Moving back to the previous cell means the solution
+            // is on the boundary between them. A cell where value() does not change with x has
+            // no single solution, and neither does a search that never settles on a cell.
+            double x = (gain != 0) ? (x_input + offset * dy) / gain : x_input;
+            int i = cell(x_nodes, x);
+            int previous = -1;
+            bool solved = false;
+            for (size_t step = 0; step < x_nodes.size(); step++) {
+                double r0 = lower[i] + (upper[i] - lower[i]) * v;
+                double r1 = lower[i + 1] + (upper[i + 1] - lower[i + 1]) * v;
+                double cell_slope = (r1 - r0) / (x_nodes[i + 1] - x_nodes[i]);
+                double denominator = gain + cell_slope;
+                if (denominator == 0) {
+                    break;
+                }
+                x = (x_input + offset * dy - r0 + cell_slope * x_nodes[i]) / denominator;
+                int next = cell(x_nodes, x);
+                if (next == i || next == previous) {
+                    solved = true;
+                    break;
+                }
+                previous = i;
+                i = next;
+            }
+            if (!solved) {
+                return x_input;
+            }
+
+            // Solutions a rounding error below the table still count as inside
+            double margin = 1e-9 * (x_nodes.back() - x_nodes.front());
+            if (!(x >= x_nodes.front() - margin && x < x_nodes.back() - margin)) {
+                return x_input;
+            }
+            return std::max(x, x_nodes.front());
+        }
+
+        /**
+         * @brief Table value the model and residual give at (x, y), the forward direction of find()
+        */
+        double value(double x, double y) const {
+            x = std::min(std::max(x, x_nodes.front()), x_nodes.back());
+            y = std::min(std::max(y, y_nodes.front()), y_nodes.back());
+            int i = cell(x_nodes, x);
+            int j = cell(y_nodes, y);
+            double u = (x - x_nodes[i]) / (x_nodes[i + 1] - x_nodes[i]);
+            double v = (y - y_nodes[j]) / (y_nodes[j + 1] - y_nodes[j]);
+            const double *lower = &residuals[(size_t)j * x_nodes.size() + i];
+            const double *upper = lower + x_nodes.size();
+            double low = lower[0] + (lower[1] - lower[0]) * u;
+            double high = upper[0] + (upper[1] - upper[0]) * u;
+            return x + (slope * x - offset) * (y - reference_y) + low + (high - low) * v;
+        }
+
+        /**
+         * @brief Largest difference to lut.find() over the table's cells and the cell midpoints
+         * @details Large tables are checked on a subset of about max_points cells, spread evenly
+        */
+        template <typename LUT>
+        double max_error(LUT &lut, size_t max_points = 20000) const {
+            std::vector<double> lut_y_ref = lut.getYRef();
+            size_t stride = (size_t)std::sqrt((double)(lut.getXRef().size() * lut_y_ref.size()) / max_points) + 1;
+            double error = 0;
+            for (size_t row = 0; row < lut_y_ref.size(); row += stride) {
+                std::vector<double> values = lut[row];
+                std::vector<double> next = (row + 1 < lut_y_ref.size()) ? lut[row + 1] : values;
+                for (size_t i = 0; i < values.size(); i += stride) {
+                    error = std::max(error, std::fabs(find(values[i], lut_y_ref[row]) - lut.find(values[i], lut_y_ref[row])));
+                    if (row + 1 < lut_y_ref.size() && i + 1 < values.size()) {
+                        double x = 0.25 * (values[i] + values[i + 1] + next[i] + next[i + 1]);
+                        double y = 0.5 * (lut_y_ref[row] + lut_y_ref[row + 1]);
+                        error = std::max(error, std::fabs(find(x, y) - lut.find(x, y)));
+                    }
+                }
+            }
+            return error;
+        }
+
+        double getSlope() const { return slope; }
+        double getIsothermalPoint() const { return (slope != 0) ? offset / slope : 0; }
+        double getReferenceY() const { return reference_y; }
+        int getResidualXLen() const { return (int)x_nodes.size(); }
+        int getResidualYLen() const { return (int)y_nodes.size(); }
+
+        /**
+         * @brief Bytes used by the residual grid, its nodes and the model
+        */
+        size_t memory_usage() const {
+            return (residuals.size() + x_nodes.size() + y_nodes.size() + 3) * sizeof(double);
+        }
+
+    private:
+        std::vector<double> x_ref;      ///< The table being fitted, released once the residual is sampled
+        std::vector<double> y_ref;
+        std::vector<std::vector<double>> rows;
+        double slope = 0;
+        double offset = 0;
+        double reference_y = 0;
+        std::vector<double> x_nodes;    ///< Ascending nodes of the residual grid, spanning the table
+        std::vector<double> y_nodes;
+        std::vector<double> residuals;  ///< y_nodes.size() rows of x_nodes.size()
+
+        ModelResidualLUT() { }
+
+        template <typename LUT>
+        void load_table(LUT &lut) {
+            x_ref = lut.getXRef();
+            y_ref = lut.getYRef();
+            if (x_ref.size() < 2 || y_ref.size() < 2) {
+                throw std::invalid_argument("The table needs at least 2 points per axis");
+            }
+            if (!std::is_sorted(x_ref.begin(), x_ref.end()) || !std::is_sorted(y_ref.begin(), y_ref.end())) {
+                throw std::invalid_argument("The model needs ascending reference values");
+            }
+            for (size_t row = 0; row < y_ref.size(); row++) {
+                rows.push_back(lut[row]);
+            }
+        }
+
+        void release_table() {
+            x_ref = std::vector<double>();
+            y_ref = std::vector<double>();
+            rows = std::vector<std::vector<double>>();
+        }
+
+        static std::vector<double> uniform_nodes(const std::vector<double> &ref, int len) {
+            std::vector<double> nodes(len);
+            for (int i = 0; i < len; i++) {
+                nodes[i] = ref.front() + (ref.back() - ref.front()) * i / (len - 1);
+            }
+            nodes.back() = ref.back();
+            return nodes;
+        }
+
+        /**
+         * @brief Lower node of the cell holding value, clamped to the first and last cell
+        */
+        static int cell(const std::vector<double> &nodes, double value) {
+            int i = (int)(std::upper_bound(nodes.begin(), nodes.end(), value) - nodes.begin()) - 1;
+            return std::min(std::max(i, 0), (int)nodes.size() - 2);
+        }
+
+        /**
+         * @brief Least squares fit of table - x = slope * x * dy - offset * dy, with dy = y - reference_y
+         * @details The reference y is the row that is closest to the x-reference values themselves
+        */
+        void fit_model() {
+            double closest = std::numeric_limits<double>::infinity();
+            for (size_t row = 0; row < y_ref.size(); row++) {
+                double distance = 0;
+                for (size_t i = 0; i < x_ref.size(); i++) {
+                    distance += std::fabs(rows[row][i] - x_ref[i]);
+                }
+                if (distance < closest) {
+                    closest = distance;
+                    reference_y = y_ref[row];
+                }
+            }
+
+            // Normal equations of the two parameter fit
+            double saa = 0, sab = 0, sbb = 0, sar = 0, sbr = 0;
+            for (size_t row = 0; row < y_ref.size(); row++) {
+                double dy = y_ref[row] - reference_y;
+                for (size_t i = 0; i < x_ref.size(); i++) {
+                    double a = x_ref[i] * dy;
+                    double b = -dy;
+                    double r = rows[row][i] - x_ref[i];
+                    saa += a * a;
+                    sab += a * b;
+                    sbb += b * b;
+                    sar += a * r;
+                    sbr += b * r;
+                }
+            }
+            double det = saa * sbb - sab * sab;
+            if (std::fabs(det) > 1e-12 * std::max(1.0, saa * sbb)) {
+                slope = (sar * sbb - sbr * sab) / det;
+                offset = (saa * sbr - sab * sar) / det;
+            }
+        }
+
+        /**
+         * @brief Residual of the table at (x, y), interpolated bilinearly between the table's own points
+        */
+        double table_residual(double x, double y) const {
+            int i = cell(x_ref, x);
+            int j = cell(y_ref, y);
+            double u = (x - x_ref[i]) / (x_ref[i + 1] - x_ref[i]);
+            double v = (y - y_ref[j]) / (y_ref[j + 1] - y_ref[j]);
+            auto at = [&](int row, int column) {
+                return rows[row][column] - (x_ref[column] + (slope * x_ref[column] - offset) * (y_ref[row] - reference_y));
+            };
+            double low = at(j, i) + (at(j, i + 1) - at(j, i)) * u;
+            double high = at(j + 1, i) + (at(j + 1, i + 1) - at(j + 1, i)) * u;
+            return low + (high - low) * v;
+        }
+
+        void sample_residual(const std::vector<double> &new_x_nodes, const std::vector<double> &new_y_nodes) {
+            x_nodes = new_x_nodes;
+            y_nodes = new_y_nodes;
+            residuals.resize(x_nodes.size() * y_nodes.size());
+            for (size_t j = 0; j < y_nodes.size(); j++) {
+                for (size_t i = 0; i < x_nodes.size(); i++) {
+                    residuals[j * x_nodes.size() + i] = table_residual(x_nodes[i], y_nodes[j]);
+                }
+            }
+        }
+};
+
+/******************************************************************************
+                Range bounds for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief A rectangle of inputs for CompensationBounds, inclusive at both ends
+*/
+struct RangeQuery {
+    double y_min;
+    double y_max;
+    double x_min;
+    double x_max;
+};
+
+/**
+ * @brief Bounds on every find() result inside a RangeQuery
+*/
+struct RangeBounds {
+    double lower;
+    double upper;
+    bool out_of_range;  ///< Whether some inputs may be out of range of the table, which find() returns unchanged
+};
+
+/**
+ * @brief Guaranteed bounds of InterpolableLUT::find() over ranges of inputs, without sampling
+ * @details Inside a cell, the blended row find() searches stays between the smallest and largest
+ *      of the cell's corners, so x_input can only be found in cells whose corners span it, and
+ *      the result then lies between the cell's two x-reference values. The minimum and maximum
+ *      corner of every cell are kept per cell, and per block of rows in a segment tree over the
+ *      y-direction. Each tree node holds the running maximum of the cells' maxima from the left
+ *      and the running minimum of their minima from the right, which are sorted, so the first
+ *      and last cell a node can match are found by binary search. A query visits O(log y_len)
+ *      nodes with one O(log x_len) search each.
+ *
+ *      A node also keeps the range of x_input that is inside every one of its blended rows. Any
+ *      other part of the query may be out of range, and is included in the bounds as is.
+ *      Missing cells of a masked table are treated the way find() treats them. The bounds
+ *      allow for the rounding of ComputeT, and hold for the table version they were built
+ *      from. Both reference lists must be sorted.
+*/
+class CompensationBounds {
+
+    public:
+        template <typename StorageT, typename ComputeT>
+        CompensationBounds(const BasicInterpolableLUT<StorageT, ComputeT> &lut):table_id(lut.getTableId()), version(lut.getVersion()) {
+            std::vector<double> x_ref = lut.getXRef();
+            std::vector<double> y_ref = lut.getYRef();
+            if (x_ref.size() < 2 || y_ref.size() < 2) {
+                throw std::invalid_argument("Range bounds need at least 2 points per axis");
+            }
+            SortOrder x_order = detect_sort_order(x_ref.data(), (int)x_ref.size());
+            SortOrder y_order = detect_sort_order(y_ref.data(), (int)y_ref.size());
+            if (x_order == SortOrder::Unsorted || y_order == SortOrder::Unsorted) {
+                throw std::invalid_argument("Range bounds need sorted reference values");
+            }
+            int x_len = (int)x_ref.size();
+            int y_len = (int)y_ref.size();
+            rows = y_len - 1;
+            columns = x_len - 1;
+
+            // Cells are stored in ascending x and y, whichever way the table runs
+            bool x_reversed = (x_order == SortOrder::Descending);
+            bool y_reversed = (y_order == SortOrder::Descending);
+            y_nodes.resize(y_len);
+            for (int j = 0; j < y_len; j++) {
+                y_nodes[j] = y_ref[y_reversed ? y_len - 1 - j : j];
+            }
+            cell_left.resize(columns);
+            cell_right.resize(columns);
+            for (int c = 0; c < columns; c++) {
+                int i = x_reversed ? columns - 1 - c : c;
+                cell_left[c] = std::min(x_ref[i], x_ref[i + 1]);
+                cell_right[c] = std::max(x_ref[i], x_ref[i + 1]);
+            }
+
+            std::vector<std::vector<double>> values(y_len);
+            double largest_value = 0;
+            double largest_x = std::max(std::fabs(x_ref.front()), std::fabs(x_ref.back()));
+            for (int row = 0; row < y_len; row++) {
+                values[row] = lut[row];
+                for (int i = 0; i < x_len; i++) {
+                    if (lut.isValid(row, i)) {
+                        largest_value = std::max(largest_value, std::fabs(values[row][i]));
+                    }
+                }
+            }
+            value_slack = 4 * std::numeric_limits<ComputeT>::epsilon() * largest_value;
+            result_slack = 4 * std::numeric_limits<double>::epsilon() * largest_x;
+
+            cell_min.assign((size_t)rows * columns, std::numeric_limits<double>::infinity());
+            cell_max.assign((size_t)rows * columns, -std::numeric_limits<double>::infinity());
+            nodes = 2 * rows;
+            prefix_max.assign((size_t)nodes * columns, -std::numeric_limits<double>::infinity());
+            suffix_min.assign((size_t)nodes * columns, std::numeric_limits<double>::infinity());
+            inside_min.assign(nodes, -std::numeric_limits<double>::infinity());
+            inside_max.assign(nodes, std::numeric_limits<double>::infinity());
+            lut_parallel_for(rows, [&](size_t r) {
+                int j = y_reversed ? rows - 1 - (int)r : (int)r;
+                build_leaf((int)r, values[j], values[j + 1], [&](int row, int i) { return lut.isValid(row, i); }, j, x_reversed);
+            });
+            for (int node = rows - 1; node >= 1; node--) {
+                combine(node);
+            }
+        }
+
+        /**
+         * @brief Bounds on find(x, y) for every y in [y_min, y_max] and x in [x_min, x_max]
+        */
+        RangeBounds bounds(double y_min, double y_max, double x_min, double x_max) const {
+            if (!(y_min <= y_max) || !(x_min <= x_max)) {
+                throw std::invalid_argument("Range bounds need min <= max, and no NaN");
+            }
+            RangeBounds result = { std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), false };
+            double inside_lower = -std::numeric_limits<double>::infinity();
+            double inside_upper = std::numeric_limits<double>::infinity();
+            if (y_max >= y_nodes.front() && y_min < y_nodes.back()) {
+                int first = row_of(y_min);
+                int last = row_of(y_max);
+                for (int l = first + rows, r = last + rows + 1; l < r; l >>= 1, r >>= 1) {
+                    if (l & 1) {
+                        visit(l++, x_min, x_max, result, inside_lower, inside_upper);
+                    }
+                    if (r & 1) {
+                        visit(--r, x_min, x_max, result, inside_lower, inside_upper);
+                    }
+                }
+            }
+
+            // Whatever may be out of range comes back unchanged
+            if (y_min < y_nodes.front() || y_max >= y_nodes.back() || !(inside_lower <= inside_upper)) {
+                include_unchanged(result, x_min, x_max);
+            } else {
+                if (x_min < inside_lower) {
+                    include_unchanged(result, x_min, std::min(x_max, inside_lower));
+                }
+                if (x_max >= inside_upper) {
+                    include_unchanged(result, std::max(x_min, inside_upper), x_max);
+                }
+            }
+            return result;
+        }
+
+        /**
+         * @brief bounds() for len queries, in parallel on the shared LUTExecutor
+        */
+        void bounds(const RangeQuery *queries, RangeBounds *out, size_t len) const {
+            LUTExecutor::shared().parallel_for(len, 256, [&](size_t begin, size_t end) {
+                for (size_t q = begin; q < end; q++) {
+                    out[q] = bounds(queries[q].y_min, queries[q].y_max, queries[q].x_min, queries[q].x_max);
+                }
+            });
+        }
+
+        /**
+         * @brief Whether find() can give more than threshold anywhere in the range
+        */
+        bool mayExceed(double y_min, double y_max, double x_min, double x_max, double threshold) const {
+            return bounds(y_min, y_max, x_min, x_max).upper > threshold;
+        }
+
+        /**
+         * @brief Smallest and largest corner of a cell, in ascending x and y order; +-infinity if find() never searches it
+        */
+        double cellMin(int row, int column) const {
+            check_cell(row, column);
+            return cell_min[(size_t)row * columns + column];
+        }
+
+        double cellMax(int row, int column) const {
+            check_cell(row, column);
+            return cell_max[(size_t)row * columns + column];
+        }
+
+        uint64_t getTableId() const { return table_id; }
+        uint64_t getVersion() const { return version; }
+
+        size_t memory_usage() const {
+            return (cell_min.size() + cell_max.size() + prefix_max.size() + suffix_min.size() + inside_min.size()
+                    + inside_max.size() + y_nodes.size() + cell_left.size() + cell_right.size()) * sizeof(double);
+        }
+
+    private:
+        uint64_t table_id;
+        uint64_t version;
+        int rows;                           ///< Cells in the y-direction
+        int columns;                        ///< Cells in the x-direction
+        int nodes;                          ///< Segment tree nodes, leaves at [rows, 2 * rows)
+        double value_slack;                 ///< Rounding of a blended value in ComputeT
+        double result_slack;                ///< Rounding of a result
+        std::vector<double> y_nodes;        ///< y-reference values, ascending
+        std::vector<double> cell_left;      ///< Smaller x-reference value of each column of cells, ascending
+        std::vector<double> cell_right;
+        std::vector<double> cell_min;       ///< Smallest corner of each cell, rows of columns
+        std::vector<double> cell_max;
+        std::vector<double> prefix_max;     ///< Per node, the largest cell_max over its rows and all columns up to each column
+        std::vector<double> suffix_min;     ///< Per node, the smallest cell_min over its rows and all columns from each column on
+        std::vector<double> inside_min;     ///< Per node, x_input from here to inside_max is in range of all its rows
+        std::vector<double> inside_max;
+
+        void check_cell(int row, int column) const {
+            if (row < 0 || column < 0 || row >= rows || column >= columns) {
+                throw std::out_of_range("Cell index out of range");
+            }
+        }
+
+        /**
+         * @brief Row of cells holding y, with the same [lower, upper) convention as find()
+        */
+        int row_of(double y) const {
+            int row = (int)(std::upper_bound(y_nodes.begin(), y_nodes.end(), y) - y_nodes.begin()) - 1;
+            return std::min(std::max(row, 0), rows - 1);
+        }
+
+        /**
+         * @brief Cell bounds of one row of cells, from table rows lower and upper
+        */
+        template <typename Valid>
+        void build_leaf(int r, const std::vector<double> &lower, const std::vector<double> &upper, Valid valid, int j, bool x_reversed) {
+            // Range of the blended row at each column, over every y of the cell
+            int x_len = columns + 1;
+            std::vector<double> low(x_len, std::numeric_limits<double>::infinity());
+            std::vector<double> high(x_len, -std::numeric_limits<double>::infinity());
+            std::vector<char> present(x_len, 0);
+            for (int i = 0; i < x_len; i++) {
+                if (valid(j, i)) {
+                    low[i] = std::min(low[i], lower[i]);
+                    high[i] = std::max(high[i], lower[i]);
+                    present[i] = 1;
+                }
+                if (valid(j + 1, i)) {
+                    low[i] = std::min(low[i], upper[i]);
+                    high[i] = std::max(high[i], upper[i]);
+                    present[i] = 1;
+                }
+            }
+            // find() puts a column missing from both rows on the line between its neighbours,
+            // and leaves out the columns before the first and after the last present one
+            int first = (int)(std::find(present.begin(), present.end(), 1) - present.begin());
+            int last = x_len - 1 - (int)(std::find(present.rbegin(), present.rend(), 1) - present.rbegin());
+            for (int i = first + 1, left = first; i < last; i++) {
+                if (present[i]) {
+                    left = i;
+                    continue;
+                }
+                int right = i + 1;
+                while (!present[right]) {
+                    right++;
+                }
+                low[i] = std::min(low[left], low[right]);
+                high[i] = std::max(high[left], high[right]);
+            }
+
+            double in_low = std::numeric_limits<double>::infinity();
+            double in_high = -std::numeric_limits<double>::infinity();
+            if (last - first >= 1) {
+                for (int i = first; i <= last; i++) {
+                    in_low = std::min(in_low, high[i]);
+                    in_high = std::max(in_high, low[i]);
+                }
+                in_low += value_slack;
+                in_high -= value_slack;
+            }
+            int node = rows + r;
+            inside_min[node] = in_low;
+            inside_max[node] = in_high;
+
+            double *minima = &cell_min[(size_t)r * columns];
+            double *maxima = &cell_max[(size_t)r * columns];
+            for (int c = 0; c < columns; c++) {
+                int i = x_reversed ? columns - 1 - c : c;
+                if (i >= first && i + 1 <= last) {
+                    minima[c] = std::min(low[i], low[i + 1]) - value_slack;
+                    maxima[c] = std::max(high[i], high[i + 1]) + value_slack;
+                }
+            }
+            double *running_max = &prefix_max[(size_t)node * columns];
+            double *running_min = &suffix_min[(size_t)node * columns];
+            for (int c = 0; c < columns; c++) {
+                running_max[c] = std::max(maxima[c], (c > 0) ? running_max[c - 1] : -std::numeric_limits<double>::infinity());
+            }
+            for (int c = columns - 1; c >= 0; c--) {
+                running_min[c] = std::min(minima[c], (c < columns - 1) ? running_min[c + 1] : std::numeric_limits<double>::infinity());
+            }
+        }
+
+        void combine(int node) {
+            const double *left_max = &prefix_max[(size_t)(2 * node) * columns];
+            const double *right_max = &prefix_max[(size_t)(2 * node + 1) * columns];
+            const double *left_min = &suffix_min[(size_t)(2 * node) * columns];
+            const double *right_min = &suffix_min[(size_t)(2 * node + 1) * columns];
+            double *running_max = &prefix_max[(size_t)node * columns];
+            double *running_min = &suffix_min[(size_t)node * columns];
+            for (int c = 0; c < columns; c++) {
+                running_max[c] = std::max(left_max[c], right_max[c]);
+                running_min[c] = std::min(left_min[c], right_min[c]);
+            }
+            inside_min[node] = std::max(inside_min[2 * node], inside_min[2 * node + 1]);
+            inside_max[node] = std::min(inside_max[2 * node], inside_max[2 * node + 1]);
+        }
+
+        /**
+         * @brief Adds the cells of a node that can hold a value in [x_min, x_max] to the bounds
+         * @details The first cell whose maximum reaches x_min and the last cell whose minimum
+         *      reaches x_max enclose every cell that can match
+        */
+        void visit(int node, double x_min, double x_max, RangeBounds &result, double &inside_lower, double &inside_upper) const {
+            const double *running_max = &prefix_max[(size_t)node * columns];
+            const double *running_min = &suffix_min[(size_t)node * columns];
+            int first = (int)(std::lower_bound(running_max, running_max + columns, x_min) - running_max);
+            int last = (int)(std::upper_bound(running_min, running_min + columns, x_max) - running_min) - 1;
+            if (first <= last) {
+                result.lower = std::min(result.lower, cell_left[first] - result_slack);
+                result.upper = std::max(result.upper, cell_right[last] + result_slack);
+            }
+            inside_lower = std::max(inside_lower, inside_min[node]);
+            inside_upper = std::min(inside_upper, inside_max[node]);
+        }
+
+        static void include_unchanged(RangeBounds &result, double x_min, double x_max) {
+            result.lower = std::min(result.lower, x_min);
+            result.upper = std::max(result.upper, x_max);
+            result.out_of_range = true;
+        }
+};
+
+/******************************************************************************
+                Monte Carlo uncertainty for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Philox4x32-10 counter-based random numbers: one 128-bit block per 128-bit counter
+ * @details The same counter and key always give the same block, whichever thread asks and
+ *      in whatever order, so random streams need no state and can be split freely.
+*/
+inline void lut_philox(const uint32_t counter[4], uint32_t k0, uint32_t k1, uint32_t out[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+        uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+/**
+ * @brief lut_philox() for 8 counters at once, counter[word][lane] and out[word][lane]
+ * @details Each 32-bit word sits in a 64-bit lane, so a 32 x 32 to 64-bit multiply gives both
+ *      halves of a Philox product in one instruction. The rounds are one long dependency chain,
+ *      so two registers of 4 lanes are interleaved to keep the multiplier busy.
+*/
+inline void lut_philox8(const uint32_t counter[4][8], uint32_t k0, uint32_t k1, uint32_t out[4][8]) {
+#if defined(__AVX2__)
+    __m256i c[2][4];
+    for (int half = 0; half < 2; half++) {
+        for (int word = 0; word < 4; word++) {
+            c[half][word] = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)&counter[word][4 * half]));
+        }
+    }
+    const __m256i m0 = _mm256_set1_epi64x(0xD2511F53u);
+    const __m256i m1 = _mm256_set1_epi64x(0xCD9E8D57u);
+    const __m256i low = _mm256_set1_epi64x(0xFFFFFFFFu);
+    for (int round = 0; round < 10; round++) {
+        const __m256i key0 = _mm256_set1_epi64x(k0);
+        const __m256i key1 = _mm256_set1_epi64x(k1);
+        for (int half = 0; half < 2; half++) {
+            __m256i p0 = _mm256_mul_epu32(m0, c[half][0]);
+            __m256i p1 = _mm256_mul_epu32(m1, c[half][2]);
+            __m256i n0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c[half][1]), key0);
+            __m256i n2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c[half][3]), key1);
+            c[half][1] = _mm256_and_si256(p1, low);
+            c[half][3] = _mm256_and_si256(p0, low);
+            c[half][0] = n0;
+            c[half][2] = n2;
+        }
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    for (int half = 0; half < 2; half++) {
+        for (int word = 0; word < 4; word++) {
+            _mm_storeu_si128((__m128i *)&out[word][4 * half], _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(c[half][word], pack)));
+        }
+    }
+#else
+    for (int lane = 0; lane < 8; lane++) {
+        uint32_t lane_counter[4] = { counter[0][lane], counter[1][lane], counter[2][lane], counter[3][lane] };
+        uint32_t lane_out[4];
+        lut_philox(lane_counter, k0, k1, lane_out);
+        for (int word = 0; word < 4; word++) {
+            out[word][lane] = lane_out[word];
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Settings of a MonteCarloEngine. Uncertainties are standard deviations of normal errors.
+*/
+struct MonteCarloConfig {
+    uint32_t variants = 4096;   ///< Perturbed tables per sample
+    double table_sigma = 0;     ///< Of every table cell, independently
+    double x_sigma = 0;         ///< Of x_input
+    double y_sigma = 0;         ///< Of y_input
+    uint64_t seed = 1;
+};
+
+/**
+ * @brief Distribution of the results of all variants for one sample
+*/
+struct PercentileBand {
+    double mean;
+    double stddev;
+    std::vector<double> values;  ///< One per percentile the engine was made with, in the same order
+};
+
+/**
+ * @brief Propagates calibration uncertainty through InterpolableLUT::find() by Monte Carlo
+ * @details Variant v of the table has every cell perturbed by its own normal error, and each
+ *      sample's inputs are perturbed again for every variant. Every error is a function of its
+ *      Philox counter (the cell or the sample, the variant and the stream), so variant v is the
+ *      same table for every sample, results do not depend on threads or call order, and a run
+ *      is reproduced by its seed.
+ *
+ *      Because any error can be computed on its own, the perturbed table is never built. Each
+ *      variant follows find(): the y bracket of its perturbed y, then a binary search of the
+ *      blended row that perturbs only the cells it probes, so a variant costs O(log x_len)
+ *      random numbers instead of a table. Variants run 4 at a time in lanes that step through
+ *      the search together, with the random numbers of all 4 made by one lut_philox8() call
+ *      (AVX2 when available). Tables whose rows are not all sorted the same way are searched
+ *      with a linear scan, one variant at a time.
+ *
+ *      The perturbed rows are searched as if they kept the table's sort order, which holds
+ *      while table_sigma is small against the spacing of the row. Tables with a mask are not
+ *      supported.
+*/
+class MonteCarloEngine {
+
+    public:
+        template <typename StorageT, typename ComputeT>
+        MonteCarloEngine(const BasicInterpolableLUT<StorageT, ComputeT> &lut, const MonteCarloConfig &config,
+                         const std::vector<double> &percentiles = { 2.5, 50, 97.5 })
+                :config(config), percentiles(percentiles), x_ref(lut.getXRef()), y_ref(lut.getYRef()) {
+            if (lut.hasMask()) {
+                throw std::invalid_argument("Monte Carlo needs a table without a mask");
+            }
+            if (lut.getYOrder() == SortOrder::Unsorted) {
+                throw std::invalid_argument("Monte Carlo needs sorted y-reference values");
+            }
+            if (config.variants == 0) {
+                throw std::invalid_argument("Monte Carlo needs at least one variant");
+            }
+            for (double p : percentiles) {
+                if (!(p >= 0 && p <= 100)) {
+                    throw std::invalid_argument("Percentiles must be between 0 and 100");
+                }
+            }
+            x_len = (int)x_ref.size();
+            y_len = (int)y_ref.size();
+            y_order = lut.getYOrder();
+            row_order = (y_len > 0) ? lut.getRowOrder(0) : SortOrder::Unsorted;
+            for (int row = 0; row < y_len; row++) {
+                std::vector<double> values = lut[row];
+                table.insert(table.end(), values.begin(), values.end());
+                if (lut.getRowOrder(row) != row_order) {
+                    row_order = SortOrder::Unsorted;
+                }
+            }
+            k0 = (uint32_t)config.seed;
+            k1 = (uint32_t)(config.seed >> 32);
+        }
+
+        /**
+         * @brief Results of every variant for one sample, config.variants values to out
+         * @param sample Index of the sample, which picks the errors of its inputs
+        */
+        void variants(uint64_t sample, double x_input, double y_input, double *out) const {
+            if (row_order == SortOrder::Unsorted) {
+                for (uint32_t v = 0; v < config.variants; v++) {
+                    out[v] = run_one(sample, v, x_input, y_input);
+                }
+                return;
+            }
+            for (uint32_t v = 0; v < config.variants; v += 4) {
+                double lanes[4];
+                run_lanes(sample, v, x_input, y_input, lanes);
+                std::copy(lanes, lanes + std::min<uint32_t>(4, config.variants - v), out + v);
+            }
+        }
+
+        /**
+         * @brief Mean, standard deviation and percentiles over the variants for one sample
+        */
+        PercentileBand propagate(uint64_t sample, double x_input, double y_input) const {
+            thread_local std::vector<double> results;
+            results.resize(config.variants);
+            variants(sample, x_input, y_input, results.data());
+            return band(results);
+        }
+
+        /**
+         * @brief propagate() for len samples in parallel, sample i being first_sample + i
+        */
+        void propagate(const double *x_input, const double *y_input, PercentileBand *out, size_t len,
+                       uint64_t first_sample = 0, LUTExecutor &executor = LUTExecutor::shared()) const {
+            executor.parallel_for(len, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    out[i] = propagate(first_sample + i, x_input[i], y_input[i]);
+                }
+            });
+        }
+
+        const MonteCarloConfig &getConfig() const { return config; }
+        const std::vector<double> &getPercentiles() const { return percentiles; }
+
+    private:
+        enum Stream : uint32_t {
+            CellStream = 0,     ///< Counter index is the cell, row-major
+            InputStream = 1     ///< Counter index is the sample, x and y errors from one block
+        };
+
+        MonteCarloConfig config;
+        std::vector<double> percentiles;
+        std::vector<double> x_ref;
+        std::vector<double> y_ref;
+        std::vector<double> table;  ///< Copy of the table, row-major
+        int x_len;
+        int y_len;
+        SortOrder y_order;
+        SortOrder row_order;        ///< Direction shared by every row, Unsorted if they differ
+        uint32_t k0;                ///< Philox key, from the seed
+        uint32_t k1;
+
+        /**
+         * @brief Standard normal quantile of p in (0, 1), by Acklam's rational approximation
+         * @details Relative error below 1.2e-9. Only the 5% of draws in the tails need a log.
+        */
+        static double normal_quantile(double p) {
+            static const double a[6] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                         1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+            static const double b[5] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                         6.680131188771972e+01, -1.328068155288572e+01 };
+            static const double c[6] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                         -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+            static const double d[4] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                         3.754408661907416e+00 };
+            const double tail = 0.02425;
+            if (p >= tail && p <= 1 - tail) {
+                double q = p - 0.5;
+                double r = q * q;
+                return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+                       (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+            }
+            double q = std::sqrt(-2 * std::log(std::min(p, 1 - p)));
+            double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+                       ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+            return (p < tail) ? x : -x;
+        }
+
+        /**
+         * @brief Standard normal from two words of a Philox block, through a 53-bit uniform in (0, 1)
+        */
+        static double normal(uint32_t high, uint32_t low) {
+            const double scale = 1.0 / 9007199254740992.0;
+            return normal_quantile(((double)(((uint64_t)high << 21) | (low >> 11)) + 0.5) * scale);
+        }
+
+        double cell_error(uint32_t variant, size_t cell) const {
+            uint32_t counter[4] = { (uint32_t)cell, (uint32_t)((uint64_t)cell >> 32), variant, CellStream };
+            uint32_t block[4];
+            lut_philox(counter, k0, k1, block);
+            return config.table_sigma * normal(block[0], block[1]);
+        }
+
+        void input_errors(uint64_t sample, uint32_t variant, double *x_error, double *y_error) const {
+            uint32_t counter[4] = { (uint32_t)sample, (uint32_t)(sample >> 32), variant, InputStream };
+            uint32_t block[4];
+            lut_philox(counter, k0, k1, block);
+            *x_error = config.x_sigma * normal(block[0], block[1]);
+            *y_error = config.y_sigma * normal(block[2], block[3]);
+        }
+
+        bool y_bracket(double y, int *lower) const {
+            int upper;
+            return (y_order == SortOrder::Descending) ? lut_bracket_sorted<true>(y_ref.data(), y_len, y, lower, &upper)
+                                                      : lut_bracket_sorted<false>(y_ref.data(), y_len, y, lower, &upper);
+        }
+
+        /**
+         * @brief One variant, as find() on its perturbed table
+        */
+        double run_one(uint64_t sample, uint32_t variant, double x_input, double y_input) const {
+            double x_error, y_error;
+            input_errors(sample, variant, &x_error, &y_error);
+            double x = x_input + x_error;
+            double y = y_input + y_error;
+            int row;
+            if (!y_bracket(y, &row)) {
+                return x;
+            }
+            double t = (y - y_ref[row]) / (y_ref[row + 1] - y_ref[row]);
+            auto blended = [&](int i) {
+                size_t lower = (size_t)row * x_len + i;
+                size_t upper = lower + x_len;
+                double lo = table[lower] + cell_error(variant, lower);
+                double hi = table[upper] + cell_error(variant, upper);
+                return lo + (hi - lo) * t;
+            };
+            double previous = blended(0);
+            for (int i = 0; i + 1 < x_len; i++) {
+                double next = blended(i + 1);
+                if (((previous <= x) && (next > x)) || ((previous > x) && (next <= x))) {
+                    return x_ref[i] + (x_ref[i + 1] - x_ref[i]) * (x - previous) / (next - previous);
+                }
+                previous = next;
+            }
+            return x;
+        }
+
+        /**
+         * @brief Variants first_variant to first_variant + 3, stepping through the search together
+        */
+        void run_lanes(uint64_t sample, uint32_t first_variant, double x_input, double y_input, double *out) const {
+            uint32_t counter[4][8];
+            uint32_t block[4][8];
+            double x[4], t[4];
+            int row[4];
+            bool in_range[4];
+
+            // Lanes 4 to 7 only pad the block, their errors are not used
+            for (int lane = 0; lane < 8; lane++) {
+                counter[0][lane] = (uint32_t)sample;
+                counter[1][lane] = (uint32_t)(sample >> 32);
+                counter[2][lane] = first_variant + (lane & 3);
+                counter[3][lane] = InputStream;
+            }
+            lut_philox8(counter, k0, k1, block);
+            for (int lane = 0; lane < 4; lane++) {
+                x[lane] = x_input + config.x_sigma * normal(block[0][lane], block[1][lane]);
+                double y = y_input + config.y_sigma * normal(block[2][lane], block[3][lane]);
+                // Lanes out of range keep computing on the first pair and are replaced at the end
+                in_range[lane] = y_bracket(y, &row[lane]);
+                if (!in_range[lane]) {
+                    row[lane] = 0;
+                }
+                t[lane] = (y - y_ref[row[lane]]) / (y_ref[row[lane] + 1] - y_ref[row[lane]]);
+            }
+
+            // Perturbed blended row of every lane at its own column, lanes 0 to 3 for the
+            // lower row and 4 to 7 for the upper row of the blocks
+            for (int lane = 0; lane < 8; lane++) {
+                counter[3][lane] = CellStream;
+            }
+            auto blended = [&](const int (&column)[4], double (&value)[4]) {
+                for (int lane = 0; lane < 4; lane++) {
+                    size_t cell = (size_t)row[lane] * x_len + column[lane];
+                    counter[0][lane] = (uint32_t)cell;
+                    counter[1][lane] = (uint32_t)((uint64_t)cell >> 32);
+                    counter[0][lane + 4] = (uint32_t)(cell + x_len);
+                    counter[1][lane + 4] = (uint32_t)((uint64_t)(cell + x_len) >> 32);
+                }
+                lut_philox8(counter, k0, k1, block);
+                for (int lane = 0; lane < 4; lane++) {
+                    size_t cell = (size_t)row[lane] * x_len + column[lane];
+                    double lo = table[cell] + config.table_sigma * normal(block[0][lane], block[1][lane]);
+                    double hi = table[cell + x_len] + config.table_sigma * normal(block[0][lane + 4], block[1][lane + 4]);
+                    value[lane] = lo + (hi - lo) * t[lane];
+                }
+            };
+            bool descending = (row_order == SortOrder::Descending);
+            auto before = [&](double value, double search) { return descending ? (value > search) : (value <= search); };
+
+            // lut_bracket_sorted() in every lane
+            int first[4] = { 0, 0, 0, 0 };
+            double value[4];
+            blended(first, value);
+            for (int lane = 0; lane < 4; lane++) {
+                in_range[lane] = in_range[lane] && x_len >= 2 && before(value[lane], x[lane]);
+            }
+            for (int len = x_len; len > 1; ) {
+                int half = len / 2;
+                int probe[4];
+                for (int lane = 0; lane < 4; lane++) {
+                    probe[lane] = first[lane] + half;
+                }
+                blended(probe, value);
+                for (int lane = 0; lane < 4; lane++) {
+                    first[lane] += before(value[lane], x[lane]) ? half : 0;
+                }
+                len -= half;
+            }
+            int next[4];
+            for (int lane = 0; lane < 4; lane++) {
+                in_range[lane] = in_range[lane] && first[lane] < x_len - 1;
+                first[lane] = std::min(first[lane], std::max(x_len - 2, 0));
+                next[lane] = first[lane] + 1;
+            }
+            double lower_value[4];
+            double upper_value[4];
+            blended(first, lower_value);
+            blended(next, upper_value);
+            for (int lane = 0; lane < 4; lane++) {
+                out[lane] = in_range[lane]
+                    ? x_ref[first[lane]] + (x_ref[next[lane]] - x_ref[first[lane]]) * (x[lane] - lower_value[lane]) / (upper_value[lane] - lower_value[lane])
+                    : x[lane];
+            }
+        }
+
+        PercentileBand band(std::vector<double> &results) const {
+            PercentileBand result;
+            double sum = 0;
+            for (double r : results) {
+                sum += r;
+            }
+            result.mean = sum / results.size();
+            double squares = 0;
+            for (double r : results) {
+                squares += (r - result.mean) * (r - result.mean);
+            }
+            result.stddev = (results.size() > 1) ? std::sqrt(squares / (results.size() - 1)) : 0;
+
+            // Linear interpolation between the closest ranks
+            std::sort(results.begin(), results.end());
+            for (double p : percentiles) {
+                double rank = p / 100 * (results.size() - 1);
+                size_t below = (size_t)rank;
+                size_t above = std::min(below + 1, results.size() - 1);
+                result.values.push_back(results[below] + (results[above] - results[below]) * (rank - below));
+            }
+            return result;
+        }
+};
+
+/******************************************************************************
+                Online recalibration for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Epoch-based reclamation, so that readers of published tables never take a lock
+ * @details A reader announces the global epoch in its thread's slot for as long as a Guard
+ *      lives, and then loads whatever pointer it reads. A writer that swaps a pointer out and
+ *      then advances the epoch may reuse the old object once no slot announces an epoch at or
+ *      below the one it retired at, since every later reader loads the new pointer. Slots are
+ *      kept on a lock-free list and reused by new threads once their thread has exited.
+*/
+class LUTEpoch {
+    struct Slot;
+
+    public:
+        class Guard {
+            public:
+                Guard():slot(local()) {
+                    if (slot.depth++ == 0) {
+                        slot.active.store(counter().load());
+                    }
+                }
+
+                ~Guard() {
+                    if (--slot.depth == 0) {
+                        slot.active.store(0, std::memory_order_release);
+                    }
+                }
+
+                Guard(const Guard &) = delete;
+                Guard &operator=(const Guard &) = delete;
+
+            private:
+                Slot &slot;
+        };
+
+        /**
+         * @brief Moves to the next epoch, returning the one it leaves, which is what objects swapped out just before are retired at
+        */
+        static uint64_t advance() {
+            return counter().fetch_add(1);
+        }
+
+        /**
+         * @brief Smallest epoch a reader is in, or UINT64_MAX if no reader is active
+        */
+        static uint64_t oldestActive() {
+            uint64_t oldest = UINT64_MAX;
+            for (Slot *slot = slots().load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+                uint64_t active = slot->active.load();
+                if (active != 0) {
+                    oldest = std::min(oldest, active);
+                }
+            }
+            return oldest;
+        }
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> active{0};   ///< Epoch of the reader using this slot, 0 when it reads nothing
+            std::atomic<bool> in_use{true};
+            int depth = 0;                      ///< Nested guards of the owning thread
+            Slot *next = nullptr;
+        };
+
+        /**
+         * @brief Hands the slot back when its thread exits
+        */
+        struct Owner {
+            Slot *slot = nullptr;
+            ~Owner() {
+                if (slot != nullptr) {
+                    slot->in_use.store(false, std::memory_order_release);
+                }
+            }
+        };
+
+        static std::atomic<uint64_t> &counter() {
+            static std::atomic<uint64_t> epoch(1);
+            return epoch;
+        }
+
+        static std::atomic<Slot *> &slots() {
+            static std::atomic<Slot *> head(nullptr);
+            return head;
+        }
+
+        static Slot &local() {
+            thread_local Owner owner;
+            if (owner.slot == nullptr) {
+                for (Slot *slot = slots().load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+                    bool free = false;
+                    if (slot->in_use.compare_exchange_strong(free, true)) {
+                        owner.slot = slot;
+                        return *slot;
+                    }
+                }
+                Slot *slot = new Slot();
+                slot->next = slots().load(std::memory_order_relaxed);
+                while (!slots().compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {
+                }
+                owner.slot = slot;
+            }
+            return *owner.slot;
+        }
+};
+
+/**
+ * @brief Nudges a table towards reference readings as they arrive, and publishes it to lock-free readers
+ * @details A reference reading is a sensor's raw value for a buffer whose standardized value is
+ *      known, at a known y. find() inverts the table, whose bilinear interpolation at
+ *      (standard, y) predicts the raw value from the 4 cells around it, so each reading is one
+ *      linear observation of those cells. observe() folds it in by recursive least squares,
+ *      keeping only the variance of each cell (a diagonal covariance), in O(1) per reading.
+ *      Cells drift as a random walk, so a cell's variance grows by drift_variance for every
+ *      reading since it was last touched, added when it is touched next.
+ *
+ *      Readers call find() or read() and take no lock. publish() makes the estimate visible as
+ *      a new version. It brings a retired copy of the table up to date by setting only the cells
+ *      that changed since that copy was current, then swaps it in; old copies are reused once
+ *      LUTEpoch shows no reader is left on them. observe() and publish() may be called from any
+ *      thread, and are serialized by a lock. Tables with a mask are not supported.
+*/
+template <typename LUT>
+class LUTRecalibrator {
+
+    public:
+        /**
+         * @param cell_variance Variance of every cell of the initial table
+         * @param noise_variance Variance of a raw reading
+         * @param drift_variance Growth of a cell's variance per reading
+        */
+        LUTRecalibrator(const LUT &initial, double cell_variance, double noise_variance, double drift_variance = 0)
+                :noise_variance(noise_variance), drift_variance(drift_variance),
+                 x_ref(initial.getXRef()), y_ref(initial.getYRef()) {
+            if (initial.hasMask()) {
+                throw std::invalid_argument("Recalibration needs a table without a mask");
+            }
+            if (!(cell_variance > 0) || !(noise_variance > 0) || !(drift_variance >= 0)) {
+                throw std::invalid_argument("Recalibration needs positive variances");
+            }
+            x_len = (int)x_ref.size();
+            y_len = (int)y_ref.size();
+            x_order = detect_sort_order(x_ref.data(), x_len);
+            y_order = detect_sort_order(y_ref.data(), y_len);
+            if (x_order == SortOrder::Unsorted || y_order == SortOrder::Unsorted) {
+                throw std::invalid_argument("Recalibration needs sorted reference values");
+            }
+            for (int row = 0; row < y_len; row++) {
+                std::vector<double> values = initial[row];
+                estimate.insert(estimate.end(), values.begin(), values.end());
+            }
+            variance.assign(estimate.size(), cell_variance);
+            last_touched.assign(estimate.size(), 0);
+            dirty.assign(estimate.size(), 0);
+            LUT *first = new LUT(initial);
+            first->shareTableId(initial);
+            generation = first->getVersion();
+            current.store(first);
+        }
+
+        /**
+         * @brief Frees every copy. No reader may still be inside find() or read().
+        */
+        ~LUTRecalibrator() {
+            delete current.load();
+            for (const Retired &retired : retired_copies) {
+                delete retired.lut;
+            }
+            for (LUT *spare : spares) {
+                delete spare;
+            }
+        }
+
+        LUTRecalibrator(const LUTRecalibrator &) = delete;
+        LUTRecalibrator &operator=(const LUTRecalibrator &) = delete;
+
+        /**
+         * @brief Folds in one reference reading
+         * @param standard Known standardized value of the reference, in x-reference units
+         * @param y Condition it was measured at, e.g. the temperature
+         * @param raw The sensor's raw reading
+         * @return false if (standard, y) is out of range of the table, in which case nothing changes
+        */
+        bool observe(double standard, double y, double raw) {
+            int column = 0, row = 0, upper = 0;
+            bool x_found = (x_order == SortOrder::Descending) ? lut_bracket_sorted<true>(x_ref.data(), x_len, standard, &column, &upper)
+                                                              : lut_bracket_sorted<false>(x_ref.data(), x_len, standard, &column, &upper);
+            bool y_found = (y_order == SortOrder::Descending) ? lut_bracket_sorted<true>(y_ref.data(), y_len, y, &row, &upper)
+                                                              : lut_bracket_sorted<false>(y_ref.data(), y_len, y, &row, &upper);
+            if (!x_found || !y_found || std::isnan(raw)) {
+                return false;
+            }
+            double u = (standard - x_ref[column]) / (x_ref[column + 1] - x_ref[column]);
+            double v = (y - y_ref[row]) / (y_ref[row + 1] - y_ref[row]);
+            size_t cells[4] = { (size_t)row * x_len + column, (size_t)row * x_len + column + 1,
+                                (size_t)(row + 1) * x_len + column, (size_t)(row + 1) * x_len + column + 1 };
+            double weights[4] = { (1 - u) * (1 - v), u * (1 - v), (1 - u) * v, u * v };
+
+            std::lock_guard<std::mutex> lock(writer);
+            readings++;
+            double predicted = 0;
+            double spread = noise_variance;
+            for (int k = 0; k < 4; k++) {
+                variance[cells[k]] += drift_variance * (readings - last_touched[cells[k]]);
+                last_touched[cells[k]] = readings;
+                predicted += weights[k] * estimate[cells[k]];
+                spread += weights[k] * weights[k] * variance[cells[k]];
+            }
+            double error = raw - predicted;
+            for (int k = 0; k < 4; k++) {
+                double gain = variance[cells[k]] * weights[k] / spread;
+                estimate[cells[k]] += gain * error;
+                variance[cells[k]] -= gain * weights[k] * variance[cells[k]];
+                if (weights[k] != 0 && !dirty[cells[k]]) {
+                    dirty[cells[k]] = 1;
+                    changed.push_back(cells[k]);
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Makes everything observed so far visible to readers as a new version
+         * @return The version readers see from now on
+        */
+        uint64_t publish() {
+            std::lock_guard<std::mutex> lock(writer);
+            if (changed.empty()) {
+                return generation;
+            }
+            reclaim();
+            LUT *next = nullptr;
+            if (!spares.empty()) {
+                next = spares.back();
+                spares.pop_back();
+            }
+            LUT *live = current.load();
+
+            // Cells changed since the copy was current, then the new ones
+            std::vector<size_t> cells = changed;
+            if (next != nullptr && next->getVersion() + 1 < log.front().version) {
+                *next = *live;
+            } else if (next != nullptr) {
+                for (const Publication &publication : log) {
+                    if (publication.version > next->getVersion()) {
+                        cells.insert(cells.end(), publication.cells.begin(), publication.cells.end());
+                    }
+                }
+            } else {
+                next = new LUT(*live);
+            }
+            next->shareTableId(*live);  // Every version is the same table to caches and metrics
+            std::vector<CellValue> values(cells.size());
+            for (size_t c = 0; c < cells.size(); c++) {
+                values[c] = { (int)(cells[c] / x_len), (int)(cells[c] % x_len), estimate[cells[c]] };
+            }
+            next->setCells(values.data(), values.size());
+            next->setVersion(++generation);
+
+            log.push_back({ generation, changed });
+            if (log.size() > log_length) {
+                log.pop_front();
+            }
+            for (size_t cell : changed) {
+                dirty[cell] = 0;
+            }
+            changed.clear();
+
+            LUT *previous = current.exchange(next);
+            retired_copies.push_back({ previous, LUTEpoch::advance() });
+            return generation;
+        }
+
+        /**
+         * @brief find() on the latest published version, without taking a lock
+        */
+        double find(double x_input, double y_input) {
+            LUTEpoch::Guard guard;
+            return current.load()->find(x_input, y_input);
+        }
+
+        /**
+         * @brief Calls fn with the latest published version, which stays valid until fn returns
+        */
+        template <typename F>
+        auto read(F fn) -> decltype(fn(std::declval<LUT &>())) {
+            LUTEpoch::Guard guard;
+            return fn(*current.load());
+        }
+
+        uint64_t getVersion() const {
+            return current.load()->getVersion();
+        }
+
+        /**
+         * @brief Current estimate and variance of a cell, including readings not yet published
+        */
+        double cellEstimate(int row, int column) {
+            std::lock_guard<std::mutex> lock(writer);
+            return estimate[cell_index(row, column)];
+        }
+
+        double cellVariance(int row, int column) {
+            std::lock_guard<std::mutex> lock(writer);
+            size_t cell = cell_index(row, column);
+            return variance[cell] + drift_variance * (readings - last_touched[cell]);
+        }
+
+    private:
+        struct Retired {
+            LUT *lut;
+            uint64_t epoch;     ///< Epoch it was swapped out in
+        };
+
+        struct Publication {
+            uint64_t version;
+            std::vector<size_t> cells;  ///< Cells that changed from the version before
+        };
+
+        static const size_t log_length = 8;
+
+        double noise_variance;
+        double drift_variance;
+        std::vector<double> x_ref;
+        std::vector<double> y_ref;
+        int x_len;
+        int y_len;
+        SortOrder x_order;
+        SortOrder y_order;
+
+        std::mutex writer;                  ///< Serializes observe() and publish()
+        std::vector<double> estimate;       ///< Cell values, row-major
+        std::vector<double> variance;       ///< Cell variances as of last_touched
+        std::vector<uint64_t> last_touched; ///< Reading count when each cell's variance was last brought up to date
+        uint64_t readings = 0;
+        std::vector<char> dirty;            ///< Whether each cell changed since the last publish()
+        std::vector<size_t> changed;        ///< The cells flagged in dirty
+
+        std::atomic<LUT *> current;
+        uint64_t generation;                ///< Version of current
+        std::deque<Publication> log;        ///< The last few publications, a copy older than them is replaced whole
+        std::vector<Retired> retired_copies;
+        std::vector<LUT *> spares;          ///< Retired copies no reader can reach
+
+        size_t cell_index(int row, int column) const {
+            if (row < 0 || column < 0 || row >= y_len || column >= x_len) {
+                throw std::out_of_range("Cell index out of range");
+            }
+            return (size_t)row * x_len + column;
+        }
+
+        void reclaim() {
+            uint64_t oldest = LUTEpoch::oldestActive();
+            size_t kept = 0;
+            for (const Retired &retired : retired_copies) {
+                if (retired.epoch < oldest) {
+                    spares.push_back(retired.lut);
+                } else {
+                    retired_copies[kept++] = retired;
+                }
+            }
+            retired_copies.resize(kept);
+        }
+};
+
+/******************************************************************************
+                Series result cache for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Counts of how SeriesResultCache::compensated() answered
+*/
+struct SeriesCacheStats {
+    uint64_t hits = 0;              ///< Answered from the cache alone
+    uint64_t tails = 0;             ///< Cached, with new samples computed on the end
+    uint64_t misses = 0;            ///< Not cached, computed whole
+    uint64_t invalidations = 0;     ///< Cached for another table version, computed whole
+    uint64_t computed = 0;          ///< Samples passed to find_batch()
+    uint64_t evictions = 0;
+};
+
+/**
+ * @brief Keeps compensated time series, so that repeated requests only compute what is new
+ * @details Series are appended to in time order and stored here. compensated() returns the
+ *      results of one table for the samples of a series in [t_from, t_to), and caches them
+ *      under (table id, series, t_from, t_to) together with the table version they were
+ *      computed with. A later request for the same range computes only the samples appended
+ *      since, as long as the table is still at that version. An entry made with another version
+ *      is computed again, and invalidateTable() drops every entry of one table at once, so a
+ *      new table version never touches the entries of other tables.
+ *
+ *      Least recently used entries are evicted once the cache holds more than capacity results.
+ *      All calls are serialized by one lock, and compensated() runs find_batch() under it.
+*/
+class SeriesResultCache {
+
+    public:
+        explicit SeriesResultCache(size_t capacity = (size_t)1 << 24):capacity(capacity) { }
+
+        /**
+         * @brief Adds samples to the end of a series, creating it if needed
+         * @details Times must not go backwards, within the call or from the last sample of the series.
+        */
+        void append(uint64_t series, const double *time, const double *x_input, const double *y_input, size_t len) {
+            std::lock_guard<std::mutex> lock(mutex);
+            Series &s = all_series[series];
+            double last = s.time.empty() ? -std::numeric_limits<double>::infinity() : s.time.back();
+            for (size_t i = 0; i < len; i++) {
+                if (!(time[i] >= last)) {
+                    throw std::invalid_argument("Series samples must be appended in time order");
+                }
+                last = time[i];
+            }
+            s.time.insert(s.time.end(), time, time + len);
+            s.x_input.insert(s.x_input.end(), x_input, x_input + len);
+            s.y_input.insert(s.y_input.end(), y_input, y_input + len);
+        }
+
+        void append(uint64_t series, double time, double x_input, double y_input) {
+            append(series, &time, &x_input, &y_input, 1);
+        }
+
+        /**
+         * @brief find() of every sample of a series in [t_from, t_to), in time order
+        */
+        template <typename LUT>
+        std::vector<double> compensated(uint64_t series, double t_from, double t_to, LUT &lut) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = all_series.find(series);
+            if (found == all_series.end()) {
+                throw std::invalid_argument("Unknown series");
+            }
+            const Series &s = found->second;
+            size_t first = std::lower_bound(s.time.begin(), s.time.end(), t_from) - s.time.begin();
+            size_t end = std::max(first, (size_t)(std::lower_bound(s.time.begin(), s.time.end(), t_to) - s.time.begin()));
+
+            Key key = { lut.getTableId(), series, t_from, t_to };
+            auto cached = entries.find(key);
+            if (cached != entries.end() && cached->second.version == lut.getVersion() && cached->second.first == first) {
+                Entry &entry = cached->second;
+                size_t done = first + entry.results.size();
+                if (done < end) {
+                    stats.tails++;
+                    compute(lut, s, done, end, entry.results);
+                    held += end - done;
+                } else {
+                    stats.hits++;
+                }
+                order.splice(order.begin(), order, entry.recent);
+                std::vector<double> result = entry.results;
+                evict();
+                return result;
+            }
+
+            if (cached != entries.end()) {
+                stats.invalidations++;
+                drop(cached);
+            } else {
+                stats.misses++;
+            }
+            Entry entry;
+            entry.version = lut.getVersion();
+            entry.first = first;
+            compute(lut, s, first, end, entry.results);
+            held += entry.results.size();
+            order.push_front(key);
+            entry.recent = order.begin();
+            std::vector<double> result = entry.results;
+            entries.emplace(key, std::move(entry));
+            evict();
+            return result;
+        }
+
+        /**
+         * @brief Drops every entry computed with a table, e.g. when it gets a new version
+        */
+        void invalidateTable(uint64_t table_id) {
+            std::lock_guard<std::mutex> lock(mutex);
+            const double lowest = -std::numeric_limits<double>::infinity();
+            auto it = entries.lower_bound({ table_id, 0, lowest, lowest });
+            while (it != entries.end() && it->first.table_id == table_id) {
+                it = drop(it);
+            }
+        }
+
+        /**
+         * @brief Drops a series and every entry computed from it
+        */
+        void removeSeries(uint64_t series) {
+            std::lock_guard<std::mutex> lock(mutex);
+            all_series.erase(series);
+            for (auto it = entries.begin(); it != entries.end(); ) {
+                it = (it->first.series == series) ? drop(it) : std::next(it);
+            }
+        }
+
+        SeriesCacheStats getStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+        /**
+         * @brief Number of cached results
+        */
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return held;
+        }
+
+    private:
+        struct Series {
+            std::vector<double> time;
+            std::vector<double> x_input;
+            std::vector<double> y_input;
+        };
+
+        struct Key {
+            uint64_t table_id;
+            uint64_t series;
+            double t_from;
+            double t_to;
+
+            bool operator<(const Key &other) const {
+                if (table_id != other.table_id) {
+                    return table_id < other.table_id;
+                }
+                if (series != other.series) {
+                    return series < other.series;
+                }
+                if (t_from != other.t_from) {
+                    return t_from < other.t_from;
+                }
+                return t_to < other.t_to;
+            }
+        };
+
+        struct Entry {
+            uint64_t version;
+            size_t first;                   ///< Index of the first sample of the range in its series
+            std::vector<double> results;    ///< Results of the samples from first on
+            std::list<Key>::iterator recent;
+        };
+
+        size_t capacity;
+        size_t held = 0;                    ///< Results in all entries
+        mutable std::mutex mutex;
+        std::map<uint64_t, Series> all_series;
+        std::map<Key, Entry> entries;       ///< Ordered by table first, so that a table's entries are one range
+        std::list<Key> order;               ///< Most recently used first
+        SeriesCacheStats stats;
+
+        template <typename LUT>
+        void compute(LUT &lut, const Series &s, size_t begin, size_t end, std::vector<double> &results) {
+            size_t offset = results.size();
+            results.resize(offset + (end - begin));
+            lut.find_batch(&s.x_input[begin], &s.y_input[begin], results.data() + offset, end - begin);
+            stats.computed += end - begin;
+        }
+
+        std::map<Key, Entry>::iterator drop(std::map<Key, Entry>::iterator it) {
+            held -= it->second.results.size();
+            order.erase(it->second.recent);
+            return entries.erase(it);
+        }
+
+        void evict() {
+            while (held > capacity && order.size() > 1) {
+                drop(entries.find(order.back()));
+                stats.evictions++;
+            }
+        }
+};
+
+/******************************************************************************
+                Pinned pipeline for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Pins the calling thread to one CPU
+ * @return false if cpu is negative, or pinning failed or is not supported on this platform
+*/
+inline bool lut_pin_thread(int cpu) {
+#if defined(__linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+struct PipelineConfig {
+    size_t block_len = 4096;    ///< Samples per block
+    size_t depth = 4;           ///< Blocks cycling through the stages, at least 2
+    int acquire_cpu = -1;       ///< CPU each stage is pinned to, -1 to leave the stage to the scheduler
+    int compensate_cpu = -1;
+    int publish_cpu = -1;
+};
+
+struct PipelineStats {
+    size_t blocks = 0;
+    size_t samples = 0;
+    double seconds = 0;
+    double latency_p50_us = 0;      ///< From a block being acquired to it being published
+    double latency_p99_us = 0;
+    double latency_max_us = 0;
+    double compensate_p50_us = 0;   ///< find_batch() of one block
+    double compensate_p99_us = 0;
+    bool pinned = false;            ///< Every stage given a CPU was pinned to it
+};
+
+/**
+ * @brief Acquisition, compensation and publishing of a sample stream, each on its own thread
+ * @details The stages hand fixed-size blocks to each other around a ring of depth blocks,
+ *      without copying them. The acquiring stage fills a block's x and y in place, the
+ *      compensating stage runs find_batch() from them into the block's results, and the
+ *      publishing stage reads all three before the block goes back to the acquiring stage.
+ *      With the default 4 blocks each stage has a block waiting while it works on one, so a
+ *      stage is only held up when another one falls behind for a whole block.
+ *
+ *      Each stage can be pinned to a CPU in PipelineConfig, so that the scheduler cannot move
+ *      it and the data it works on stays in that core's caches. The compensating stage reads
+ *      the whole table with prefetchTable() before its first block, which keeps a table that
+ *      fits the caches of its core resident there from the start. A stage waits for its next
+ *      block by spinning briefly and then yielding.
+*/
+template <typename LUT>
+class LUTPipeline {
+
+    public:
+        /**
+         * @param lut Table the compensating stage uses, which must outlive the pipeline
+        */
+        LUTPipeline(LUT &lut, const PipelineConfig &config = PipelineConfig()):lut(lut), config(config) {
+            if (config.block_len == 0 || config.depth < 2) {
+                throw std::invalid_argument("The pipeline needs blocks of at least 1 sample and at least 2 blocks");
+            }
+            // Arrays are whole cache lines from the first 64-byte boundary of the storage, so
+            // neighbours never share a line. A vector only promises alignof(double), hence the
+            // extra line to move the start into.
+            size_t stride = (config.block_len + 7) / 8 * 8;
+            storage.resize(3 * stride * config.depth + 8);
+            size_t first = (64 - (size_t)((uintptr_t)storage.data() % 64)) % 64 / sizeof(double);
+            blocks = std::vector<Block>(config.depth);
+            for (size_t b = 0; b < config.depth; b++) {
+                blocks[b].x_input = &storage[first + 3 * stride * b];
+                blocks[b].y_input = blocks[b].x_input + stride;
+                blocks[b].out = blocks[b].y_input + stride;
+            }
+        }
+
+        LUTPipeline(const LUTPipeline &) = delete;
+        LUTPipeline &operator=(const LUTPipeline &) = delete;
+
+        /**
+         * @brief Streams blocks through the stages until acquire returns 0
+         * @param acquire size_t(double *x_input, double *y_input, size_t capacity), which fills
+         *      up to capacity samples and returns how many it filled, or 0 at the end of the stream
+         * @param publish void(const double *x_input, const double *y_input, const double *out, size_t len)
+         * @details Returns once every acquired block has been published. The first exception
+         *      thrown by a stage stops the others and is rethrown here.
+        */
+        template <typename Acquire, typename Publish>
+        PipelineStats run(Acquire acquire, Publish publish) {
+            for (Block &block : blocks) {
+                block.stage.store(Free, std::memory_order_relaxed);
+            }
+            failed.store(false, std::memory_order_relaxed);
+            std::exception_ptr errors[3];
+            std::atomic<int> pins_wanted(0);
+            std::atomic<int> pins_made(0);
+            std::vector<double> latency_us;
+            std::vector<double> compensate_us;
+            PipelineStats stats;
+
+            auto stage = [&](int index, int cpu, std::function<void()> body) {
+                return std::thread([&, index, cpu, body]() {
+                    if (cpu >= 0) {
+                        pins_wanted++;
+                        pins_made += lut_pin_thread(cpu);
+                    }
+                    try {
+                        body();
+                    } catch (...) {
+                        errors[index] = std::current_exception();
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                });
+            };
+
+            auto start = std::chrono::steady_clock::now();
+            std::thread threads[3] = {
+                stage(0, config.acquire_cpu, [&]() {
+                    for (size_t n = 0;; n++) {
+                        Block &block = blocks[n % blocks.size()];
+                        if (!wait(block, Free)) {
+                            return;
+                        }
+                        block.len = acquire(block.x_input, block.y_input, config.block_len);
+                        if (block.len > config.block_len) {
+                            throw std::out_of_range("acquire filled more samples than the block holds");
+                        }
+                        block.acquired = std::chrono::steady_clock::now();
+                        block.stage.store(Acquired, std::memory_order_release);
+                        if (block.len == 0) {
+                            return;
+                        }
+                    }
+                }),
+                stage(1, config.compensate_cpu, [&]() {
+                    lut.prefetchTable();
+                    for (size_t n = 0;; n++) {
+                        Block &block = blocks[n % blocks.size()];
+                        if (!wait(block, Acquired)) {
+                            return;
+                        }
+                        if (block.len > 0) {
+                            auto begin = std::chrono::steady_clock::now();
+                            lut.find_batch(block.x_input, block.y_input, block.out, block.len);
+                            compensate_us.push_back(std::chrono::duration<double, std::micro>(
+                                                        std::chrono::steady_clock::now() - begin).count());
+                        }
+                        block.stage.store(Compensated, std::memory_order_release);
+                        if (block.len == 0) {
+                            return;
+                        }
+                    }
+                }),
+                stage(2, config.publish_cpu, [&]() {
+                    for (size_t n = 0;; n++) {
+                        Block &block = blocks[n % blocks.size()];
+                        if (!wait(block, Compensated) || block.len == 0) {
+                            return;
+                        }
+                        publish((const double *)block.x_input, (const double *)block.y_input, (const double *)block.out, block.len);
+                        latency_us.push_back(std::chrono::duration<double, std::micro>(
+                                                 std::chrono::steady_clock::now() - block.acquired).count());
+                        stats.blocks++;
+                        stats.samples += block.len;
+                        block.stage.store(Free, std::memory_order_release);
+                    }
+                })
+            };
+            for (std::thread &thread : threads) {
+                thread.join();
+            }
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (std::exception_ptr &error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            stats.latency_p50_us = percentile(latency_us, 0.50);
+            stats.latency_p99_us = percentile(latency_us, 0.99);
+            stats.latency_max_us = percentile(latency_us, 1.0);
+            stats.compensate_p50_us = percentile(compensate_us, 0.50);
+            stats.compensate_p99_us = percentile(compensate_us, 0.99);
+            stats.pinned = (pins_wanted.load() > 0 && pins_made.load() == pins_wanted.load());
+            return stats;
+        }
+
+    private:
+        enum BlockStage : uint32_t {
+            Free,           ///< Ready to be filled by the acquiring stage
+            Acquired,       ///< Ready for the compensating stage
+            Compensated     ///< Ready for the publishing stage
+        };
+
+        struct Block {
+            std::atomic<uint32_t> stage{Free};
+            size_t len = 0;
+            std::chrono::steady_clock::time_point acquired;
+            double *x_input = nullptr;
+            double *y_input = nullptr;
+            double *out = nullptr;
+            char padding[64];   ///< Keeps the stages' writes to neighbouring blocks off each other's lines
+        };
+
+        LUT &lut;
+        PipelineConfig config;
+        std::vector<double> storage;    ///< x, y and results of every block, from a 64-byte boundary on
+        std::vector<Block> blocks;
+        std::atomic<bool> failed{false};
+
+        bool wait(const Block &block, uint32_t stage) const {
+            for (int spins = 0; block.stage.load(std::memory_order_acquire) != stage; spins++) {
+                if (failed.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                if (spins >= 64) {
+                    std::this_thread::yield();
+                }
+            }
+            return true;
+        }
+
+        static double percentile(std::vector<double> &values, double fraction) {
+            if (values.empty()) {
+                return 0;
+            }
+            size_t index = std::min(values.size() - 1, (size_t)(fraction * (values.size() - 1) + 0.5));
+            std::nth_element(values.begin(), values.begin() + index, values.end());
+            return values[index];
+        }
+};
+
+/******************************************************************************
+                C interface for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief What an ilut_table handle points to, one implementation per precision mode
+*/
+struct ilut_table {
+    virtual ~ilut_table() { }
+    virtual double find(double x_input, double y_input) = 0;
+    virtual void find_batch(const double *x_input, const double *y_input, double *out, size_t len) = 0;
+    virtual uint64_t getTableId() const = 0;
+
+    int x_len;
+    int y_len;
+};
+
+template <typename LUT>
+struct ilut_table_impl : ilut_table {
+    LUT lut;
+
+    template <typename... Args>
+    ilut_table_impl(int x_len, int y_len, Args&&... args):lut(std::forward<Args>(args)...) {
+        this->x_len = x_len;
+        this->y_len = y_len;
+    }
+
+    double find(double x_input, double y_input) override {
+        return lut.find(x_input, y_input);
+    }
+
+    void find_batch(const double *x_input, const double *y_input, double *out, size_t len) override {
+        lut.find_batch(x_input, y_input, out, len);
+    }
+
+    uint64_t getTableId() const override {
+        return lut.getTableId();
+    }
+};
+
+static std::string &ilut_error_message() {
+    thread_local std::string message;
+    return message;
+}
+
+static ilut_status ilut_fail(ilut_status status, const char *message) {
+    ilut_error_message() = message;
+    return status;
+}
+
+/**
+ * @brief Runs fn, turning any exception into an ilut_status
+*/
+template <typename F>
+static ilut_status ilut_guard(F fn) {
+    try {
+        fn();
+        return ILUT_OK;
+    } catch (const std::bad_alloc &) {
+        return ilut_fail(ILUT_ERR_MEMORY, "Out of memory");
+    } catch (const std::invalid_argument &e) {
+        return ilut_fail(ILUT_ERR_ARGUMENT, e.what());
+    } catch (const std::out_of_range &e) {
+        return ilut_fail(ILUT_ERR_ARGUMENT, e.what());
+    } catch (const std::exception &e) {
+        return ilut_fail(ILUT_ERR_INTERNAL, e.what());
+    } catch (...) {
+        return ilut_fail(ILUT_ERR_INTERNAL, "Unknown exception");
+    }
+}
+
+template <typename... Args>
+static ilut_table *ilut_make(ilut_precision precision, int x_len, int y_len, Args&&... args) {
+    switch (precision) {
+        case ILUT_DOUBLE:
+            return new ilut_table_impl<InterpolableLUT>(x_len, y_len, std::forward<Args>(args)...);
+        case ILUT_FLOAT:
+            return new ilut_table_impl<InterpolableLUTf>(x_len, y_len, std::forward<Args>(args)...);
+        case ILUT_MIXED:
+            return new ilut_table_impl<InterpolableLUTMixed>(x_len, y_len, std::forward<Args>(args)...);
+    }
+    throw std::invalid_argument("Unknown precision");
+}
+
+extern "C" {
+
+int ilut_abi_version(void) {
+    return ILUT_ABI_VERSION;
+}
+
+ilut_status ilut_create(const double *table, const double *x_ref, const double *y_ref,
+                        int x_len, int y_len, ilut_precision precision, ilut_table **out) {
+    if (out == nullptr) {
+        return ilut_fail(ILUT_ERR_NULL, "out is NULL");
+    }
+    *out = nullptr;
+    if (table == nullptr || x_ref == nullptr || y_ref == nullptr) {
+        return ilut_fail(ILUT_ERR_NULL, "table, x_ref and y_ref are required");
+    }
+    if (x_len < 1 || y_len < 1) {
+        return ilut_fail(ILUT_ERR_SIZE, "x_len and y_len must be at least 1");
+    }
+    return ilut_guard([&]() {
+        std::vector<std::vector<double>> rows(y_len);
+        for (int row = 0; row < y_len; row++) {
+            rows[row].assign(table + (size_t)row * x_len, table + (size_t)(row + 1) * x_len);
+        }
+        *out = ilut_make(precision, x_len, y_len, rows,
+                         std::vector<double>(x_ref, x_ref + x_len), std::vector<double>(y_ref, y_ref + y_len), x_len, y_len);
+    });
+}
+
+ilut_status ilut_create_masked(const double *table, const unsigned char *valid, ilut_missing_cells missing,
+                               const double *x_ref, const double *y_ref,
+                               int x_len, int y_len, ilut_precision precision, ilut_table **out) {
+    if (out == nullptr) {
+        return ilut_fail(ILUT_ERR_NULL, "out is NULL");
+    }
+    *out = nullptr;
+    if (table == nullptr || valid == nullptr || x_ref == nullptr || y_ref == nullptr) {
+        return ilut_fail(ILUT_ERR_NULL, "table, valid, x_ref and y_ref are required");
+    }
+    if (x_len < 1 || y_len < 1) {
+        return ilut_fail(ILUT_ERR_SIZE, "x_len and y_len must be at least 1");
+    }
+    if (missing != ILUT_FILL_NEAREST && missing != ILUT_FILL_INTERPOLATE && missing != ILUT_MASK_PER_QUERY) {
+        return ilut_fail(ILUT_ERR_ARGUMENT, "Unknown missing cell mode");
+    }
+    return ilut_guard([&]() {
+        std::vector<std::vector<double>> rows(y_len);
+        std::vector<std::vector<bool>> flags(y_len);
+        for (int row = 0; row < y_len; row++) {
+            rows[row].assign(table + (size_t)row * x_len, table + (size_t)(row + 1) * x_len);
+            flags[row].assign(valid + (size_t)row * x_len, valid + (size_t)(row + 1) * x_len);
+        }
+        MissingCells mode = (missing == ILUT_FILL_NEAREST) ? MissingCells::FillNearest :
+                            (missing == ILUT_FILL_INTERPOLATE) ? MissingCells::FillInterpolate : MissingCells::MaskPerQuery;
+        *out = ilut_make(precision, x_len, y_len, rows, flags, mode,
+                         std::vector<double>(x_ref, x_ref + x_len), std::vector<double>(y_ref, y_ref + y_len), x_len, y_len);
+    });
+}
+
+void ilut_free(ilut_table *lut) {
+    delete lut;
+}
+
+ilut_status ilut_find(ilut_table *lut, double x_input, double y_input, double *out) {
+    if (lut == nullptr || out == nullptr) {
+        return ilut_fail(ILUT_ERR_NULL, "lut and out are required");
+    }
+    return ilut_guard([&]() {
+        *out = lut->find(x_input, y_input);
+    });
+}
+
+ilut_status ilut_find_batch(ilut_table *lut, const double *x_input, const double *y_input, double *out, size_t len) {
+    if (len == 0) {
+        return ILUT_OK;
+    }
+    if (lut == nullptr || x_input == nullptr || y_input == nullptr || out == nullptr) {
+        return ilut_fail(ILUT_ERR_NULL, "lut, x_input, y_input and out are required");
+    }
+    return ilut_guard([&]() {
+        lut->find_batch(x_input, y_input, out, len);
+    });
+}
+
+ilut_status ilut_get_size(const ilut_table *lut, int *x_len, int *y_len) {
+    if (lut == nullptr || x_len == nullptr || y_len == nullptr) {
+        return ilut_fail(ILUT_ERR_NULL, "lut, x_len and y_len are required");
+    }
+    *x_len = lut->x_len;
+    *y_len = lut->y_len;
+    return ILUT_OK;
+}
+
+ilut_status ilut_get_table_id(const ilut_table *lut, uint64_t *table_id) {
+    if (lut == nullptr || table_id == nullptr) {
+        return ilut_fail(ILUT_ERR_NULL, "lut and table_id are required");
+    }
+    *table_id = lut->getTableId();
+    return ILUT_OK;
+}
+
+const char *ilut_status_string(ilut_status status) {
+    switch (status) {
+        case ILUT_OK: return "OK";
+        case ILUT_ERR_NULL: return "Required pointer is NULL";
+        case ILUT_ERR_SIZE: return "Invalid table size";
+        case ILUT_ERR_ARGUMENT: return "Invalid argument";
+        case ILUT_ERR_MEMORY: return "Out of memory";
+        case ILUT_ERR_INTERNAL: return "Internal error";
+    }
+    return "Unknown status";
+}
+
+const char *ilut_last_error(void) {
+    return ilut_error_message().c_str();
+}
+
+}
+
+/******************************************************************************
+                Example for the InterpolateLLUT class
+*******************************************************************************/
+#define NUM_TEMP_POINTS 12
+#define NUM_PH_POINTS 7
+
+/**
+ * @brief Reference lists and table of the example pH calibration, which the examples and
+ *      benchmarks below share
+*/
+struct ExamplePhTable {
+    std::vector<double> temp_points;
+    std::vector<double> ph_values_at_25;
+    std::vector<std::vector<double>> ph_values;
+};
+
+ExamplePhTable example_ph_table() {
+    ExamplePhTable ph_table;
+    ph_table.temp_points = {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55};
+    ph_table.ph_values_at_25 = {1.68, 4.01, 6.86, 7.00, 9.18, 10.01, 12.46};
+
+    // pH values at each temperature point for each pH buffer
+    ph_table.ph_values = {
+        {1.67, 4.01, 6.98, 7.12, 9.46, 10.32, 13.47}, // 0°C
+        {1.67, 4.01, 6.95, 7.09, 9.39, 10.25, 13.25}, // 5°C
+        {1.67, 4.00, 6.92, 7.06, 9.32, 10.18, 13.03}, // 10°C
+        {1.67, 4.00, 6.90, 7.04, 9.27, 10.12, 12.83}, // 15°C
+        {1.68, 4.00, 6.88, 7.02, 9.22, 10.06, 12.64}, // 20°C
+        {1.68, 4.01, 6.86, 7.00, 9.18, 10.01, 12.46}, // 25°C
+        {1.69, 4.01, 6.85, 6.98, 9.14,  9.97, 12.29}, // 30°C
+        {1.69, 4.02, 6.84, 6.98, 9.10,  9.93, 12.14}, // 35°C
+        {1.70, 4.03, 6.84, 6.97, 9.07,  9.89, 11.99}, // 40°C
+        {1.70, 4.04, 6.83, 6.97, 9.04,  9.86, 11.86}, // 45°C
+        {1.71, 4.06, 6.83, 6.97, 9.01,  9.83, 11.73}, // 50°C
+        {1.72, 4.08, 6.83, 6.97, 8.99,  9.81, 11.61}  // 55°C
+    };
+    return ph_table;
+}
+
+/**
+ * @brief Reference lists and table of a synthetic calibration, for benchmarks that need more
+ *      points than the example has
+*/
+struct SyntheticTable {
+    std::vector<double> x_ref;
+    std::vector<double> y_ref;
+    std::vector<std::vector<double>> table;
+};
+
+/**
+ * @brief A buffer every 0.01 pH from 1.68 and a row every 0.1 degrees from 0, turning around
+ *      pH 4.5 like the example, plus an optional ripple that keeps the rows from being straight
+*/
+SyntheticTable synthetic_ph_table(int x_len, int y_len, double ripple = 0) {
+    SyntheticTable synthetic;
+    synthetic.x_ref.resize(x_len);
+    synthetic.y_ref.resize(y_len);
+    synthetic.table.assign(y_len, std::vector<double>(x_len));
+    for (int i = 0; i < x_len; i++) {
+        synthetic.x_ref[i] = 1.68 + 0.01 * i;
+    }
+    for (int row = 0; row < y_len; row++) {
+        synthetic.y_ref[row] = 0.1 * row;
+        for (int i = 0; i < x_len; i++) {
+            double x = synthetic.x_ref[i];
+            double y = synthetic.y_ref[row];
+            synthetic.table[row][i] = x + (0.003 * x - 0.0135) * (y - 25);
+            if (ripple != 0) {
+                synthetic.table[row][i] += ripple * std::sin(3 * x + 0.1 * y);
+            }
+        }
+    }
+    return synthetic;
+}
+
+/**
+ * @brief Buffers spread evenly from pH 1 to 14 and rows from 0 to 100 degrees, turning around pH 7
+*/
+SyntheticTable spread_ph_table(int x_len, int y_len) {
+    SyntheticTable synthetic;
+    synthetic.x_ref.resize(x_len);
+    synthetic.y_ref.resize(y_len);
+    synthetic.table.assign(y_len, std::vector<double>(x_len));
+    for (int i = 0; i < x_len; i++) {
+        synthetic.x_ref[i] = 1.0 + 13.0 * i / (x_len - 1);
+    }
+    for (int j = 0; j < y_len; j++) {
+        synthetic.y_ref[j] = 100.0 * j / (y_len - 1);
+        for (int i = 0; i < x_len; i++) {
+            synthetic.table[j][i] = synthetic.x_ref[i] - 0.0035 * (synthetic.y_ref[j] - 25.0) * (synthetic.x_ref[i] - 7.0);
+        }
+    }
+    return synthetic;
+}
+
+/**
+ * @brief Reference values 0, 1, 2, ... on both axes, each row a ramp a little steeper than the one before
+*/
+SyntheticTable ramp_table(int x_len, int y_len) {
+    SyntheticTable synthetic;
+    synthetic.x_ref.resize(x_len);
+    synthetic.y_ref.resize(y_len);
+    synthetic.table.assign(y_len, std::vector<double>(x_len));
+    for (int i = 0; i < x_len; i++) {
+        synthetic.x_ref[i] = i;
+    }
+    for (int row = 0; row < y_len; row++) {
+        synthetic.y_ref[row] = row;
+        for (int i = 0; i < x_len; i++) {
+            synthetic.table[row][i] = i * (1.0 + 0.001 * row);
+        }
+    }
+    return synthetic;
+}
+
+/**
+ * @brief The i-th of a fixed sequence of fractions in [0, 1), spread evenly but out of order
+ * @details Benchmarks use these in place of random numbers so that every run sees the same
+ *      queries. Each stream is a stride through its own prime period, so streams 0, 1 and 2
+ *      can serve as x, y and a third coordinate of one query without lining up.
+*/
+double spread_fraction(long long i, int stream = 0) {
+    static const long long strides[3] = { 7919, 104729, 15485863 };
+    static const long long periods[3] = { 100003, 100019, 99991 };
+    return (double)((i * strides[stream]) % periods[stream]) / periods[stream];
+}
+
+void example() {
+    const ExamplePhTable ph_table = example_ph_table();
+
+    // Initialize the object with the example table and lists
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    printf("pH: %.2f\n", lutPh.find(7.01, 37.0));
+    printf("pH: %.2f\n", lutPh.find(7.50, 37.0));
+    printf("pH: %.2f\n", lutPh.find(8.00, 37.0));
+    printf("pH: %.2f\n", lutPh.find(8.50, 37.0));
+    printf("pH: %.2f\n", lutPh.find(9.00, 37.0));
+    printf("pH: %.2f\n", lutPh.find(10.01, 0.01));
+
+    std::cout << lutPh;
+}
+
+/**
+ * @brief Shows where the example pH table is least accurate and where to calibrate next
+*/
+void example_error_map() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    InterpolationErrorMap map(lutPh, ErrorEstimate::Curvature);
+    std::cout << map;
+
+    // Aim for 0.005 pH with at most two more rows' worth of memory
+    size_t budget = lutPh.memory_usage() + 2 * (NUM_PH_POINTS + 1) * sizeof(double);
+    for (const RefinementSuggestion &suggestion : map.advise(0.005, budget)) {
+        printf("%s %s %.2f (error %.4f, %+ld bytes)\n", suggestion.bytes > 0 ? "add" : "drop",
+               suggestion.row ? "temperature" : "buffer", suggestion.position, suggestion.error, suggestion.bytes);
+    }
+}
+
+/**
+ * @brief Records lookups of the example pH table and exports them as a scrape would see them
+*/
+void example_metrics() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    LUTMetrics metrics;
+    LUTMetricsRegistry registry;
+    registry.add("ph", &metrics);
+    lutPh.attachMetrics(&metrics);
+
+    for (int i = 0; i < 1000; i++) {
+        lutPh.find(1.0 + 0.013 * i, 0.06 * i);  // Some of these run off the table
+    }
+
+    char buffer[8192];
+    size_t length = registry.render(buffer, sizeof(buffer));
+    printf("%s(%zu bytes)\n", buffer, length);
+
+    registry.renderHttpResponse(buffer, sizeof(buffer));
+    printf("%.*s...\n", 80, buffer);
+
+    if (registry.writeFile("lut_metrics.prom")) {
+        printf("written to lut_metrics.prom\n");
+    }
+    lutPh.attachMetrics(nullptr);
+    registry.remove(&metrics);
+}
+
+/**
+ * @brief Cost of find() with and without metrics attached
+*/
+void benchmark_metrics() {
+    const ExamplePhTable ph_table = example_ph_table();
+    const std::vector<std::vector<double>> ph_values(NUM_TEMP_POINTS, ph_table.ph_values_at_25);
+    InterpolableLUT lutPh(ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    LUTMetrics metrics;
+    const int lookups = 2000000;
+    for (int attached = 0; attached < 2; attached++) {
+        lutPh.attachMetrics(attached ? &metrics : nullptr);
+        double sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++) {
+            sum += lutPh.find(2.0 + (i % 1000) * 0.01, (i % 550) * 0.1);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("metrics %-9s %6.1f ns/lookup (%g)\n", attached ? "attached" : "detached", seconds / lookups * 1e9, sum);
+    }
+    lutPh.attachMetrics(nullptr);
+}
+
+/**
+ * @brief The example pH table used through the C interface, as a C caller would
+*/
+void example_c_api() {
+    // A C caller holds the table as one row-major array
+    const ExamplePhTable ph_table = example_ph_table();
+    std::vector<double> ph_values;
+    for (const std::vector<double> &row : ph_table.ph_values) {
+        ph_values.insert(ph_values.end(), row.begin(), row.end());
+    }
+
+    ilut_table *lut = NULL;
+    ilut_status status = ilut_create(ph_values.data(), ph_table.ph_values_at_25.data(), ph_table.temp_points.data(),
+                                     NUM_PH_POINTS, NUM_TEMP_POINTS, ILUT_DOUBLE, &lut);
+    if (status != ILUT_OK) {
+        printf("ilut_create: %s (%s)\n", ilut_status_string(status), ilut_last_error());
+        return;
+    }
+
+    double ph = 0;
+    ilut_find(lut, 7.01, 37.0, &ph);
+    printf("pH: %.2f\n", ph);
+
+    double measured[4] = {7.01, 8.00, 9.00, 4.00};
+    double temperatures[4] = {37.0, 37.0, 37.0, 5.0};
+    ilut_find_batch(lut, measured, temperatures, measured, 4);
+    for (int i = 0; i < 4; i++) {
+        printf("pH: %.2f\n", measured[i]);
+    }
+
+    status = ilut_find_batch(lut, NULL, temperatures, measured, 4);
+    printf("Missing input: %s (%s)\n", ilut_status_string(status), ilut_last_error());
+    ilut_free(lut);
+}
+
+/**
+ * @brief Traces a few lookups of the example pH table, dumps them and decodes the dump
+*/
+void example_tracing() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    LUTTracer::enable(true);
+    lutPh.find(7.01, 37.0);
+    lutPh.find(13.90, 25.0);   // Above the top buffer
+    lutPh.find(7.01, 60.0);    // Above the top temperature
+    LUTTracer::enable(false);
+
+    if (LUTTracer::dump("lut_trace.bin")) {
+        LUTTracer::decode("lut_trace.bin", std::cout);
+    }
+}
+
+/**
+ * @brief Cost of find() with tracing disabled and enabled
+*/
+void benchmark_tracing() {
+    const ExamplePhTable ph_table = example_ph_table();
+    const std::vector<std::vector<double>> ph_values(NUM_TEMP_POINTS, ph_table.ph_values_at_25);
+    InterpolableLUT lutPh(ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    const int lookups = 2000000;
+    for (int on = 0; on < 2; on++) {
+        LUTTracer::enable(on);
+        double sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++) {
+            sum += lutPh.find(2.0 + (i % 1000) * 0.01, (i % 550) * 0.1);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("tracing %-8s %6.1f ns/lookup (%g)\n", on ? "enabled" : "disabled", seconds / lookups * 1e9, sum);
+    }
+    LUTTracer::enable(false);
+}
+
+/******************************************************************************
+                Precision comparison for the InterpolateLLUT storage modes
+*******************************************************************************/
+/**
+ * @brief Largest absolute difference between lut and reference over the query set, and the
+ *      throughput of lut in million lookups per second
+*/
+template <typename LUT>
+void measure_precision(const char *name, LUT &lut, InterpolableLUT &reference,
+                       const std::vector<double> &xs, const std::vector<double> &ys, int repeats) {
+    std::vector<double> expected(xs.size());
+    std::vector<double> actual(xs.size());
+    reference.find_batch(xs.data(), ys.data(), expected.data(), xs.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        lut.find_batch(xs.data(), ys.data(), actual.data(), xs.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double max_error = 0;
+    for (size_t i = 0; i < xs.size(); i++) {
+        max_error = std::max(max_error, std::fabs(actual[i] - expected[i]));
+    }
+    printf("%-8s max error %.3e  %8.2f M lookups/s  %8zu bytes\n", name, max_error,
+           (double)xs.size() * repeats / seconds / 1e6, lut.memory_usage());
+}
+
+void measure_precision_modes(const std::vector<std::vector<double>> &table, const std::vector<double> &x_ref,
+                             const std::vector<double> &y_ref, const std::vector<double> &xs,
+                             const std::vector<double> &ys, int repeats) {
+    int x_len = (int)x_ref.size();
+    int y_len = (int)y_ref.size();
+    InterpolableLUT reference(table, x_ref, y_ref, x_len, y_len);
+    InterpolableLUT lut_double(table, x_ref, y_ref, x_len, y_len);
+    InterpolableLUTf lut_float(table, x_ref, y_ref, x_len, y_len);
+    InterpolableLUTMixed lut_mixed(table, x_ref, y_ref, x_len, y_len);
+
+    measure_precision("double", lut_double, reference, xs, ys, repeats);
+    measure_precision("float", lut_float, reference, xs, ys, repeats);
+    measure_precision("mixed", lut_mixed, reference, xs, ys, repeats);
+}
+
+void benchmark_precision() {
+    const ExamplePhTable ph_table = example_ph_table();
+
+    // Queries spread over the whole table, weighted towards the alkaline end
+    std::vector<double> xs, ys;
+    for (long long i = 0; i < 100000; i++) {
+        xs.push_back(1.7 + 11.7 * std::sqrt(spread_fraction(i)));
+        ys.push_back(55.0 * spread_fraction(i, 1));
+    }
+    printf("Example pH table (%d x %d)\n", NUM_PH_POINTS, NUM_TEMP_POINTS);
+    measure_precision_modes(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, xs, ys, 20);
+
+    // Synthetic tables with the same shape of temperature dependence, but many more buffers
+    const int sizes[][2] = { {500, 100}, {2000, 500} };
+    for (const auto &size : sizes) {
+        const SyntheticTable synthetic = spread_ph_table(size[0], size[1]);
+        std::vector<double> sxs(20000), sys(20000);
+        for (size_t i = 0; i < sxs.size(); i++) {
+            sxs[i] = 1.5 + 12.0 * spread_fraction(i);
+            sys[i] = 100.0 * spread_fraction(i, 1);
+        }
+        printf("Synthetic table (%d x %d)\n", size[0], size[1]);
+        measure_precision_modes(synthetic.table, synthetic.x_ref, synthetic.y_ref, sxs, sys, 2);
+    }
+}
+
+/******************************************************************************
+                Ascending vs descending tables for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Builds the same table twice, once ascending and once with every axis and row
+ *      reversed, and checks both give the same answers at the same speed
+*/
+void benchmark_sort_order() {
+    const int x_len = 2000;
+    const int y_len = 500;
+    const SyntheticTable synthetic = spread_ph_table(x_len, y_len);
+    const std::vector<double> &x_ref = synthetic.x_ref;
+    const std::vector<double> &y_ref = synthetic.y_ref;
+    const std::vector<std::vector<double>> &table = synthetic.table;
+
+    std::vector<double> x_ref_desc(x_ref.rbegin(), x_ref.rend());
+    std::vector<double> y_ref_desc(y_ref.rbegin(), y_ref.rend());
+    std::vector<std::vector<double>> table_desc;
+    for (int j = y_len - 1; j >= 0; j--) {
+        table_desc.push_back(std::vector<double>(table[j].rbegin(), table[j].rend()));
+    }
+
+    InterpolableLUT ascending(table, x_ref, y_ref, x_len, y_len);
+    InterpolableLUT descending(table_desc, x_ref_desc, y_ref_desc, x_len, y_len);
+
+    std::vector<double> xs(200000), ys(200000), out_asc(200000), out_desc(200000);
+    for (size_t i = 0; i < xs.size(); i++) {
+        xs[i] = 1.5 + 12.0 * spread_fraction(i);
+        ys[i] = 100.0 * spread_fraction(i, 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ascending.find_batch(xs.data(), ys.data(), out_asc.data(), xs.size());
+    double asc_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    descending.find_batch(xs.data(), ys.data(), out_desc.data(), xs.size());
+    double desc_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double max_difference = 0;
+    for (size_t i = 0; i < xs.size(); i++) {
+        max_difference = std::max(max_difference, std::fabs(out_asc[i] - out_desc[i]));
+    }
+    printf("ascending  %8.3f M lookups/s\n", xs.size() / asc_seconds / 1e6);
+    printf("descending %8.3f M lookups/s\n", xs.size() / desc_seconds / 1e6);
+    printf("max difference %.3e\n", max_difference);
+}
+
+/******************************************************************************
+                Tables with missing cells for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Knocks holes into a synthetic table and compares the masked kernel against the dense
+ *      one, and against filling the holes at construction
+*/
+void benchmark_masked() {
+    const int x_len = 2000;
+    const int y_len = 500;
+    const SyntheticTable synthetic = spread_ph_table(x_len, y_len);
+    const std::vector<double> &x_ref = synthetic.x_ref;
+    const std::vector<double> &y_ref = synthetic.y_ref;
+    const std::vector<std::vector<double>> &table = synthetic.table;
+    InterpolableLUT dense(table, x_ref, y_ref, x_len, y_len);
+
+    // Queries stay inside the table, where a filled cell cannot turn a passthrough into a lookup
+    std::vector<double> xs(100000), ys(100000), expected(100000), actual(100000);
+    for (size_t i = 0; i < xs.size(); i++) {
+        xs[i] = 2.0 + 10.0 * spread_fraction(i);
+        ys[i] = 100.0 * spread_fraction(i, 1);
+    }
+    dense.find_batch(xs.data(), ys.data(), expected.data(), xs.size());
+
+    const int holes_per_thousand[] = { 1, 10, 50 };
+    for (int holes : holes_per_thousand) {
+        std::vector<std::vector<bool>> valid(y_len, std::vector<bool>(x_len, true));
+        unsigned seed = 12345;
+        for (int hole = 0; hole < x_len * y_len / 1000 * holes; hole++) {
+            seed = seed * 1664525u + 1013904223u;
+            valid[(seed >> 8) % y_len][(seed >> 16) % x_len] = false;
+        }
+        InterpolableLUT masked(table, valid, MissingCells::MaskPerQuery, x_ref, y_ref, x_len, y_len);
+        InterpolableLUT nearest(table, valid, MissingCells::FillNearest, x_ref, y_ref, x_len, y_len);
+        InterpolableLUT interpolated(table, valid, MissingCells::FillInterpolate, x_ref, y_ref, x_len, y_len);
+
+        printf("%.1f%% of cells missing\n", holes / 10.0);
+        const char *names[] = { "dense", "masked", "nearest", "interp" };
+        InterpolableLUT *luts[] = { &dense, &masked, &nearest, &interpolated };
+        for (int l = 0; l < 4; l++) {
+            auto start = std::chrono::steady_clock::now();
+            luts[l]->find_batch(xs.data(), ys.data(), actual.data(), xs.size());
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double max_error = 0;
+            for (size_t i = 0; i < xs.size(); i++) {
+                max_error = std::max(max_error, std::fabs(actual[i] - expected[i]));
+            }
+            printf("  %-8s %8.3f M lookups/s  max error vs complete table %.3e\n", names[l], xs.size() / seconds / 1e6, max_error);
+        }
+    }
+}
+
+/******************************************************************************
+                Row-major vs pair-delta layout for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Lookups per second of wide tables in both layouts, and the largest difference between them
+*/
+template <typename LUT>
+void measure_layouts(const char *name, int x_len, int y_len) {
+    std::vector<double> x_ref(x_len);
+    std::vector<double> y_ref(y_len);
+    std::vector<std::vector<double>> table(y_len, std::vector<double>(x_len));
+    for (int i = 0; i < x_len; i++) {
+        x_ref[i] = i;
+    }
+    for (int row = 0; row < y_len; row++) {
+        y_ref[row] = row;
+        for (int i = 0; i < x_len; i++) {
+            table[row][i] = i * (1.0 + 0.01 * row) + 0.5 * std::sin(0.1 * i + row);
+        }
+    }
+    LUT lut(table, x_ref, y_ref, x_len, y_len);
+
+    const int lookups = 200000;
+    std::vector<double> xs(lookups);
+    std::vector<double> ys(lookups);
+    for (long long i = 0; i < lookups; i++) {
+        xs[i] = 1.0 + spread_fraction(i) * (x_len - 3);
+        ys[i] = spread_fraction(i, 1) * (y_len - 1);
+    }
+
+    std::vector<double> results[2];
+    double rate[2];
+    for (int pass = 0; pass < 2; pass++) {
+        lut.setLayout(pass ? TableLayout::PairDelta : TableLayout::RowMajor);
+        results[pass].resize(lookups);
+        auto start = std::chrono::steady_clock::now();
+        lut.find_batch(xs.data(), ys.data(), results[pass].data(), lookups);
+        rate[pass] = lookups / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    double max_diff = 0;
+    for (int i = 0; i < lookups; i++) {
+        max_diff = std::max(max_diff, std::fabs(results[0][i] - results[1][i]));
+    }
+    printf("%-6s %5d x %-3d row-major %8.3f M/s  pair-delta %8.3f M/s  (%+5.1f%%)  max diff %g\n", name, x_len, y_len,
+           rate[0] / 1e6, rate[1] / 1e6, (rate[1] / rate[0] - 1) * 100, max_diff);
+}
+
+void benchmark_layout() {
+    const int widths[] = { 64, 512, 4096, 32768 };
+    for (int x_len : widths) {
+        measure_layouts<InterpolableLUT>("double", x_len, 64);
+        measure_layouts<InterpolableLUTf>("float", x_len, 64);
+        measure_layouts<InterpolableLUTMixed>("mixed", x_len, 64);
+    }
+}
+
+/******************************************************************************
+                Batch kernels for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief find_batch() with the queries grouped by row pair first, so each pair's rows stay in cache
+*/
+template <typename LUT>
+void find_batch_bucketed(LUT &lut, const std::vector<double> &y_ref, const double *x_input, const double *y_input,
+                         double *out, size_t len) {
+    std::vector<size_t> offsets(y_ref.size() + 1, 0);
+    std::vector<int> bucket(len);
+    for (size_t i = 0; i < len; i++) {
+        bucket[i] = (int)(std::upper_bound(y_ref.begin(), y_ref.end(), y_input[i]) - y_ref.begin());
+        offsets[bucket[i]]++;
+    }
+    size_t start = 0;
+    for (size_t &offset : offsets) {
+        size_t count = offset;
+        offset = start;
+        start += count;
+    }
+    std::vector<size_t> order(len);
+    for (size_t i = 0; i < len; i++) {
+        order[offsets[bucket[i]]++] = i;
+    }
+    for (size_t i : order) {
+        out[i] = lut.find(x_input[i], y_input[i]);
+    }
+}
+
+template <typename LUT>
+void measure_batch_kernels(const char *name, int x_len, int y_len, bool descending) {
+    std::vector<double> x_ref(x_len);
+    std::vector<double> y_ref(y_len);
+    std::vector<std::vector<double>> table(y_len, std::vector<double>(x_len));
+    for (int i = 0; i < x_len; i++) {
+        x_ref[i] = i;
+    }
+    for (int row = 0; row < y_len; row++) {
+        y_ref[row] = row;
+        for (int i = 0; i < x_len; i++) {
+            double value = i * (1.0 + 0.01 * row) + 0.3 * std::sin(0.1 * i + row);
+            table[row][descending ? x_len - 1 - i : i] = descending ? -value : value;
+        }
+    }
+    LUT lut(table, x_ref, y_ref, x_len, y_len);
+
+    // Random temperatures, a few of them outside the table
+    const size_t lookups = 400000;
+    std::vector<double> xs(lookups);
+    std::vector<double> ys(lookups);
+    for (long long i = 0; i < (long long)lookups; i++) {
+        xs[i] = (descending ? -1 : 1) * (-1.0 + spread_fraction(i) * (x_len + 1));
+        ys[i] = -0.5 + spread_fraction(i, 1) * y_len;
+    }
+
+    std::vector<double> results[3];
+    double rate[3];
+    for (int pass = 0; pass < 3; pass++) {
+        results[pass].resize(lookups);
+        auto start = std::chrono::steady_clock::now();
+        if (pass == 0) {
+            lut.find_batch(xs.data(), ys.data(), results[pass].data(), lookups, BatchKernel::Scalar);
+        } else if (pass == 1) {
+            find_batch_bucketed(lut, y_ref, xs.data(), ys.data(), results[pass].data(), lookups);
+        } else {
+            lut.find_batch(xs.data(), ys.data(), results[pass].data(), lookups, BatchKernel::Gather);
+        }
+        rate[pass] = lookups / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    size_t differences = 0;
+    for (size_t i = 0; i < lookups; i++) {
+        differences += (results[0][i] != results[2][i]) + (results[0][i] != results[1][i]);
+    }
+    printf("%-6s %4d x %-3d %-4s scalar %7.2f M/s  bucketed %7.2f M/s  gather %7.2f M/s%s  differences %zu\n",
+           name, x_len, y_len, descending ? "desc" : "asc", rate[0] / 1e6, rate[1] / 1e6, rate[2] / 1e6,
+           lut.batchKernel() == BatchKernel::Gather ? "" : " (n/a)", differences);
+}
+
+void benchmark_batch_kernels() {
+    const int sizes[][2] = { { 7, 12 }, { 64, 64 }, { 512, 64 }, { 2000, 500 } };
+    for (const auto &size : sizes) {
+        measure_batch_kernels<InterpolableLUT>("double", size[0], size[1], false);
+        measure_batch_kernels<InterpolableLUTMixed>("mixed", size[0], size[1], false);
+    }
+    measure_batch_kernels<InterpolableLUT>("double", 64, 64, true);
+}
+
+/******************************************************************************
+                Work stealing for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Skewed batches: many small tables and a few large ones, run with a static split and with the executor
+ * @details The static split hands each thread a contiguous run of batches, so the thread that
+ *      gets the large tables finishes long after the others. Prints the wall time and when
+ *      the first and last thread went idle.
+*/
+void benchmark_work_stealing() {
+    const size_t threads = 4;
+    const size_t queries = 20000;
+    std::vector<std::unique_ptr<InterpolableLUT>> tables;
+    auto make_table = [&](int x_len, int y_len) {
+        const SyntheticTable synthetic = ramp_table(x_len, y_len);
+        tables.emplace_back(new InterpolableLUT(synthetic.table, synthetic.x_ref, synthetic.y_ref, x_len, y_len));
+    };
+    for (int b = 0; b < 60; b++) {
+        make_table(7, 12);
+    }
+    for (int b = 0; b < 4; b++) {
+        make_table(2000, 500);
+    }
+
+    std::vector<std::vector<double>> xs(tables.size(), std::vector<double>(queries));
+    std::vector<std::vector<double>> ys(tables.size(), std::vector<double>(queries));
+    std::vector<std::vector<double>> outs(tables.size(), std::vector<double>(queries));
+    std::vector<LUTBatch<InterpolableLUT>> batches;
+    for (size_t b = 0; b < tables.size(); b++) {
+        std::vector<double> x_ref = tables[b]->getXRef();
+        std::vector<double> y_ref = tables[b]->getYRef();
+        for (long long i = 0; i < (long long)queries; i++) {
+            xs[b][i] = spread_fraction(i) * x_ref.back();
+            ys[b][i] = spread_fraction(i, 1) * y_ref.back();
+        }
+        batches.push_back({ tables[b].get(), xs[b].data(), ys[b].data(), outs[b].data(), queries });
+    }
+
+    // Static: contiguous runs of batches per thread
+    std::vector<double> idle_at(threads);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    size_t per_thread = (batches.size() + threads - 1) / threads;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (size_t b = t * per_thread; b < std::min(batches.size(), (t + 1) * per_thread); b++) {
+                batches[b].lut->find_batch(batches[b].x_input, batches[b].y_input, batches[b].out, batches[b].len);
+            }
+            idle_at[t] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    double static_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("static split    %7.1f ms, threads idle from %7.1f ms to %7.1f ms\n", static_seconds * 1e3,
+           *std::min_element(idle_at.begin(), idle_at.end()) * 1e3, *std::max_element(idle_at.begin(), idle_at.end()) * 1e3);
+
+    std::vector<double> reference = outs.back();
+    LUTExecutor executor(threads);
+    start = std::chrono::steady_clock::now();
+    lut_find_batches(batches, executor);
+    double stealing_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("work stealing   %7.1f ms, %llu steals, results %s (%u hardware threads)\n", stealing_seconds * 1e3,
+           (unsigned long long)executor.steals(), (outs.back() == reference) ? "match" : "differ",
+           std::thread::hardware_concurrency());
+}
+
+/******************************************************************************
+                Priority scheduling for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Latency of urgent lookups while background batches keep every worker busy
+ * @details Compares one FIFO queue with whole batches, the two priority queues with sliced
+ *      batches, and the same with one worker reserved for urgent lookups.
+*/
+void benchmark_priority() {
+    const int x_len = 2000;
+    const int y_len = 500;
+    const SyntheticTable synthetic = ramp_table(x_len, y_len);
+    InterpolableLUT archive(synthetic.table, synthetic.x_ref, synthetic.y_ref, x_len, y_len);
+    InterpolableLUT control(synthetic.table, synthetic.x_ref, synthetic.y_ref, x_len, y_len);
+
+    const size_t batch_len = 100000;
+    std::vector<double> xs(batch_len);
+    std::vector<double> ys(batch_len);
+    for (long long i = 0; i < (long long)batch_len; i++) {
+        xs[i] = spread_fraction(i) * (x_len - 1);
+        ys[i] = spread_fraction(i, 1) * (y_len - 1);
+    }
+
+    struct Setup {
+        const char *name;
+        size_t reserved;
+        size_t slice_len;
+        LUTPriority urgent;
+    };
+    const Setup setups[] = {
+        { "fifo, whole batches", 0, std::numeric_limits<size_t>::max(), LUTPriority::Background },
+        { "priority, slices of 256", 0, 256, LUTPriority::High },
+        { "priority, slices, 1 reserved", 1, 256, LUTPriority::High },
+    };
+    for (const Setup &setup : setups) {
+        LUTPriorityExecutor executor(2, setup.reserved, setup.slice_len);
+        std::vector<std::vector<double>> outs(4, std::vector<double>(batch_len));
+        std::deque<std::future<void>> pending;
+        size_t submitted = 0;
+        std::vector<double> latencies;
+        for (int request = 0; request < 300; request++) {
+            // Keep the background queue full
+            while (pending.size() < 3) {
+                pending.push_back(executor.findBatch(archive, xs.data(), ys.data(), outs[submitted++ % outs.size()].data(), batch_len));
+            }
+            while (!pending.empty() && pending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                pending.pop_front();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            executor.find(control, 1000.5, 250.25, setup.urgent).get();
+            latencies.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        for (std::future<void> &batch : pending) {
+            batch.get();
+        }
+        std::sort(latencies.begin(), latencies.end());
+        printf("%-30s p50 %9.1f us  p99 %9.1f us  max %9.1f us  (%zu background batches)\n", setup.name,
+               latencies[latencies.size() / 2] * 1e6, latencies[latencies.size() * 99 / 100] * 1e6,
+               latencies.back() * 1e6, submitted);
+    }
+}
+
+/******************************************************************************
+                Model plus residual vs full table for the InterpolateLLUT class
+*******************************************************************************/
+template <typename LUT>
+void measure_model_residual(const char *name, LUT &lut, double tolerance) {
+    ModelResidualLUT hybrid = ModelResidualLUT::fit(lut, tolerance);
+    std::vector<double> x_ref = lut.getXRef();
+    std::vector<double> y_ref = lut.getYRef();
+
+    const int lookups = 1000000;
+    std::vector<double> xs(lookups);
+    std::vector<double> ys(lookups);
+    for (long long i = 0; i < lookups; i++) {
+        ys[i] = y_ref.front() + spread_fraction(i, 1) * (y_ref.back() - y_ref.front());
+        xs[i] = hybrid.value(x_ref.front() + (0.02 + 0.96 * spread_fraction(i)) * (x_ref.back() - x_ref.front()), ys[i]);
+    }
+    double sums[2] = { 0, 0 };
+    double rates[2];
+    double max_diff = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++) {
+            sums[pass] += pass ? hybrid.find(xs[i], ys[i]) : lut.find(xs[i], ys[i]);
+        }
+        rates[pass] = lookups / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    for (int i = 0; i < lookups; i += 97) {
+        max_diff = std::max(max_diff, std::fabs(hybrid.find(xs[i], ys[i]) - lut.find(xs[i], ys[i])));
+    }
+    printf("%-10s %4zu x %-4zu %9zu bytes  %6.1f M/s | model+residual %2d x %-2d %6zu bytes  %6.1f M/s"
+           "  isothermal %.2f  cells %.4f  random %.4f  (%.2g)\n",
+           name, x_ref.size(), y_ref.size(), lut.memory_usage(), rates[0] / 1e6,
+           hybrid.getResidualXLen(), hybrid.getResidualYLen(), hybrid.memory_usage(), rates[1] / 1e6,
+           hybrid.getIsothermalPoint(), hybrid.max_error(lut), max_diff, sums[0] - sums[1]);
+}
+
+/**
+ * @brief Memory, speed and agreement of ModelResidualLUT with the full table it was fitted to
+ * @details Uses the example pH table, and a finely sampled table made from it with the same
+ *      temperature behaviour, which is where a full table spends the most memory.
+*/
+void benchmark_model_residual() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    measure_model_residual("example", lutPh, 0.005);
+
+    // Every 0.01 pH and 0.1 degrees, following a model fitted to the example plus its residual
+    ModelResidualLUT shape(lutPh, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    const int x_len = 1079;
+    const int y_len = 551;
+    SyntheticTable synthetic = synthetic_ph_table(x_len, y_len);
+    for (int row = 0; row < y_len; row++) {
+        for (int i = 0; i < x_len; i++) {
+            synthetic.table[row][i] = shape.value(synthetic.x_ref[i], synthetic.y_ref[row]);
+        }
+    }
+    InterpolableLUT dense(synthetic.table, synthetic.x_ref, synthetic.y_ref, x_len, y_len);
+    measure_model_residual("dense", dense, 0.005);
+}
+
+/******************************************************************************
+                Range bounds vs sampling for the InterpolateLLUT class
+*******************************************************************************/
+template <typename LUT>
+void measure_range_bounds(const char *name, LUT &lut) {
+    auto start = std::chrono::steady_clock::now();
+    CompensationBounds index(lut);
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::vector<double> x_ref = lut.getXRef();
+    std::vector<double> y_ref = lut.getYRef();
+    double x_low = *std::min_element(x_ref.begin(), x_ref.end());
+    double x_span = *std::max_element(x_ref.begin(), x_ref.end()) - x_low;
+    double y_low = *std::min_element(y_ref.begin(), y_ref.end());
+    double y_span = *std::max_element(y_ref.begin(), y_ref.end()) - y_low;
+
+    // Ranges of up to a tenth of each axis, some reaching past the table
+    const int queries = 20000;
+    std::vector<RangeQuery> ranges(queries);
+    for (long long q = 0; q < queries; q++) {
+        double u = spread_fraction(q);
+        double v = spread_fraction(q, 1);
+        double w = spread_fraction(q, 2);
+        double y = y_low + (1.1 * v - 0.05) * y_span;
+        double x = x_low + (1.1 * u - 0.05) * x_span;
+        ranges[q] = { y, y + 0.1 * w * y_span, x, x + 0.1 * (1 - w) * x_span };
+    }
+
+    const int samples = 16;
+    std::vector<RangeBounds> bounds(queries);
+    start = std::chrono::steady_clock::now();
+    index.bounds(ranges.data(), bounds.data(), queries);
+    double bound_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / queries;
+
+    int violations = 0;
+    double sampled_width = 0;
+    double bound_width = 0;
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++) {
+        double low = std::numeric_limits<double>::infinity();
+        double high = -std::numeric_limits<double>::infinity();
+        for (int a = 0; a < samples; a++) {
+            for (int b = 0; b < samples; b++) {
+                double y = std::min(ranges[q].y_max, ranges[q].y_min + (ranges[q].y_max - ranges[q].y_min) * a / (samples - 1));
+                double x = std::min(ranges[q].x_max, ranges[q].x_min + (ranges[q].x_max - ranges[q].x_min) * b / (samples - 1));
+                double result = lut.find(x, y);
+                low = std::min(low, result);
+                high = std::max(high, result);
+            }
+        }
+        violations += (low < bounds[q].lower || high > bounds[q].upper);
+        sampled_width += high - low;
+        bound_width += bounds[q].upper - bounds[q].lower;
+    }
+    double sample_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / queries;
+
+    printf("%-8s %4zu x %-4zu build %7.2f ms %9zu bytes | bounds %7.0f ns | %dx%d samples %9.0f ns"
+           " | width %.3f vs sampled %.3f | violations %d\n",
+           name, x_ref.size(), y_ref.size(), build_ms, index.memory_usage(), bound_ns, samples, samples, sample_ns,
+           bound_width / queries, sampled_width / queries, violations);
+}
+
+/**
+ * @brief Speed and tightness of CompensationBounds against sampling find() over each range
+ * @details Sampled extremes must never fall outside the bounds; the widths show how much the
+ *      cell corners overestimate the range.
+*/
+void benchmark_range_bounds() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    measure_range_bounds("example", lutPh);
+
+    std::vector<std::vector<bool>> valid(NUM_TEMP_POINTS, std::vector<bool>(NUM_PH_POINTS, true));
+    valid[3][2] = valid[4][2] = valid[7][0] = valid[9][6] = false;
+    InterpolableLUT masked(ph_table.ph_values, valid, MissingCells::MaskPerQuery, ph_table.ph_values_at_25, ph_table.temp_points,
+                           NUM_PH_POINTS, NUM_TEMP_POINTS);
+    measure_range_bounds("masked", masked);
+
+    const SyntheticTable synthetic = synthetic_ph_table(1079, 551, 0.002);
+    InterpolableLUTf dense(synthetic.table, synthetic.x_ref, synthetic.y_ref, 1079, 551);
+    measure_range_bounds("dense", dense);
+}
+
+/******************************************************************************
+                Averages over y for the InterpolateLLUT class
+*******************************************************************************/
+template <typename LUT>
+void measure_y_means(const char *name, LUT &lut) {
+    std::vector<double> x_ref = lut.getXRef();
+    std::vector<double> y_ref = lut.getYRef();
+    const int queries = 2000;
+    const int samples = 300;
+    std::vector<double> xs(queries), froms(queries), tos(queries);
+    // x stays clear of the ends of the rows, where find() is out of range at some temperatures only
+    for (long long q = 0; q < queries; q++) {
+        double u = spread_fraction(q);
+        double v = spread_fraction(q, 1);
+        double w = spread_fraction(q, 2);
+        xs[q] = x_ref.front() + (0.15 + 0.7 * u) * (x_ref.back() - x_ref.front());
+        froms[q] = y_ref.front() + 0.5 * v * (y_ref.back() - y_ref.front());
+        tos[q] = froms[q] + 0.5 * w * (y_ref.back() - y_ref.front());
+    }
+
+    // Mean of find() by the midpoint rule, and findMean() without and with the integrals
+    std::vector<double> results[3];
+    double ns[3];
+    for (int pass = 0; pass < 3; pass++) {
+        lut.setYIntegrals(pass == 2);
+        results[pass].resize(queries);
+        auto start = std::chrono::steady_clock::now();
+        for (int q = 0; q < queries; q++) {
+            if (pass == 0) {
+                double sum = 0;
+                for (int k = 0; k < samples; k++) {
+                    sum += lut.find(xs[q], froms[q] + (tos[q] - froms[q]) * (k + 0.5) / samples);
+                }
+                results[pass][q] = sum / samples;
+            } else {
+                results[pass][q] = lut.findMean(xs[q], froms[q], tos[q]);
+            }
+        }
+        ns[pass] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / queries;
+    }
+    double difference = 0;
+    double disagreement = 0;
+    for (int q = 0; q < queries; q++) {
+        difference = std::max(difference, std::fabs(results[2][q] - results[0][q]));
+        disagreement = std::max(disagreement, std::fabs(results[2][q] - results[1][q]));
+    }
+    printf("%-8s %4zu x %-4zu | %d x find() %9.0f ns | findMean() %7.0f ns, with integrals %5.0f ns (+%zu bytes)"
+           " | vs mean of find() %.5f | with vs without %.1g\n",
+           name, x_ref.size(), y_ref.size(), samples, ns[0], ns[1], ns[2], x_ref.size() * y_ref.size() * sizeof(double),
+           difference, disagreement);
+    lut.setYIntegrals(false);
+}
+
+/**
+ * @brief Cost of averaging over temperature ranges with and without the y integrals, and how far
+ *      the compensation by the mean table is from the mean of find()
+*/
+void benchmark_y_means() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    measure_y_means("example", lutPh);
+    printf("Mean pH for a raw 8.00 over a 10-40 degree day: %.3f\n", lutPh.findMean(8.00, 10, 40));
+
+    const SyntheticTable synthetic = synthetic_ph_table(1079, 551);
+    InterpolableLUT dense(synthetic.table, synthetic.x_ref, synthetic.y_ref, 1079, 551);
+    measure_y_means("dense", dense);
+}
+
+/******************************************************************************
+                Monte Carlo uncertainty for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief The nightly job as it was: every variant perturbs and rebuilds the whole table, then calls find()
+*/
+template <typename LUT>
+PercentileBand monte_carlo_rebuild(LUT &lut, const MonteCarloConfig &config, uint32_t variants, double x_input, double y_input,
+                                   std::mt19937_64 &rng) {
+    std::vector<double> x_ref = lut.getXRef();
+    std::vector<double> y_ref = lut.getYRef();
+    std::vector<std::vector<double>> table(y_ref.size());
+    for (size_t row = 0; row < y_ref.size(); row++) {
+        table[row] = lut[row];
+    }
+    std::normal_distribution<double> normal;
+    std::vector<double> results(variants);
+    std::vector<std::vector<double>> perturbed = table;
+    for (uint32_t v = 0; v < variants; v++) {
+        for (size_t row = 0; row < table.size(); row++) {
+            for (size_t i = 0; i < x_ref.size(); i++) {
+                perturbed[row][i] = table[row][i] + config.table_sigma * normal(rng);
+            }
+        }
+        InterpolableLUT variant(perturbed, x_ref, y_ref, (int)x_ref.size(), (int)y_ref.size());
+        results[v] = variant.find(x_input + config.x_sigma * normal(rng), y_input + config.y_sigma * normal(rng));
+    }
+    std::sort(results.begin(), results.end());
+    PercentileBand band = { 0, 0, {} };
+    for (double p : { 2.5, 50.0, 97.5 }) {
+        band.values.push_back(results[(size_t)(p / 100 * (variants - 1) + 0.5)]);
+    }
+    return band;
+}
+
+template <typename LUT>
+void measure_monte_carlo(const char *name, LUT &lut, const MonteCarloConfig &config, uint32_t rebuild_variants) {
+    MonteCarloEngine engine(lut, config);
+    std::vector<double> x_ref = lut.getXRef();
+    std::vector<double> y_ref = lut.getYRef();
+    const int samples = 64;
+    std::vector<double> xs(samples), ys(samples);
+    for (int s = 0; s < samples; s++) {
+        xs[s] = x_ref.front() + (0.1 + 0.8 * s / samples) * (x_ref.back() - x_ref.front());
+        ys[s] = y_ref.front() + (0.1 + 0.8 * ((s * 37) % samples) / samples) * (y_ref.back() - y_ref.front());
+    }
+
+    std::vector<PercentileBand> bands(samples);
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < samples; s++) {
+        bands[s] = engine.propagate(s, xs[s], ys[s]);
+    }
+    double engine_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / samples;
+
+    // The parallel batch must give the same bits as the sequential calls
+    std::vector<PercentileBand> parallel(samples);
+    engine.propagate(xs.data(), ys.data(), parallel.data(), samples);
+    bool reproducible = true;
+    for (int s = 0; s < samples; s++) {
+        reproducible &= (parallel[s].values == bands[s].values) && (parallel[s].mean == bands[s].mean);
+    }
+
+    std::mt19937_64 rng(config.seed);
+    start = std::chrono::steady_clock::now();
+    PercentileBand rebuilt = monte_carlo_rebuild(lut, config, rebuild_variants, xs[0], ys[0], rng);
+    double rebuild_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()
+                        * config.variants / rebuild_variants;
+
+    printf("%-8s %4zu x %-4zu %u variants | engine %9.0f us/sample | rebuild %12.0f us/sample%s | reproducible %s\n",
+           name, x_ref.size(), y_ref.size(), config.variants, engine_us, rebuild_us,
+           (rebuild_variants < config.variants) ? " (extrapolated)" : "", reproducible ? "yes" : "NO");
+    printf("         sample 0 at %.2f, %.1f: engine %.4f [%.4f, %.4f]  rebuild %.4f [%.4f, %.4f] from %u variants\n",
+           xs[0], ys[0], bands[0].values[1], bands[0].values[0], bands[0].values[2],
+           rebuilt.values[1], rebuilt.values[0], rebuilt.values[2], rebuild_variants);
+}
+
+/**
+ * @brief Speed of MonteCarloEngine against rebuilding a perturbed table for every variant, and
+ *      agreement of the percentile bands
+*/
+void benchmark_monte_carlo() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    MonteCarloConfig config;
+    config.table_sigma = 0.01;
+    config.x_sigma = 0.005;
+    config.y_sigma = 0.2;
+    measure_monte_carlo("example", lutPh, config, config.variants);
+
+    const SyntheticTable synthetic = synthetic_ph_table(1079, 551);
+    InterpolableLUT dense(synthetic.table, synthetic.x_ref, synthetic.y_ref, 1079, 551);
+    config.table_sigma = 0.001;
+    measure_monte_carlo("dense", dense, config, 8);
+}
+
+/******************************************************************************
+                Online recalibration for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Raw reading the table predicts for a standardized value at y, the forward direction of find()
+*/
+double recalibration_forward(const std::vector<std::vector<double>> &table, const std::vector<double> &x_ref,
+                             const std::vector<double> &y_ref, double standard, double y) {
+    size_t i = std::min((size_t)(std::upper_bound(x_ref.begin(), x_ref.end(), standard) - x_ref.begin()), x_ref.size() - 1) - 1;
+    size_t j = std::min((size_t)(std::upper_bound(y_ref.begin(), y_ref.end(), y) - y_ref.begin()), y_ref.size() - 1) - 1;
+    double u = (standard - x_ref[i]) / (x_ref[i + 1] - x_ref[i]);
+    double v = (y - y_ref[j]) / (y_ref[j + 1] - y_ref[j]);
+    double low = table[j][i] + (table[j][i + 1] - table[j][i]) * u;
+    double high = table[j + 1][i] + (table[j + 1][i + 1] - table[j + 1][i]) * u;
+    return low + (high - low) * v;
+}
+
+/**
+ * @brief How fast LUTRecalibrator follows a drifted sensor, what observe() and publish() cost,
+ *      and how readers fare while a writer publishes
+*/
+void benchmark_recalibration() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    // The installed sensor reads 0.04 high plus 1% of slope since the table was made
+    std::vector<std::vector<double>> drifted = ph_table.ph_values;
+    for (auto &row : drifted) {
+        for (double &value : row) {
+            value += 0.04 + 0.01 * (value - 7);
+        }
+    }
+    auto mean_error = [&](LUTRecalibrator<InterpolableLUT> &recalibrator) {
+        double sum = 0;
+        int count = 0;
+        for (double standard = 4.01; standard <= 10.01; standard += 0.25) {
+            for (double y = 0; y < 55; y += 2.5) {
+                double raw = recalibration_forward(drifted, ph_table.ph_values_at_25, ph_table.temp_points, standard, y);
+                sum += std::fabs(recalibrator.find(raw, y) - standard);
+                count++;
+            }
+        }
+        return sum / count;
+    };
+
+    // Reference buffers 4.01, 6.86, 9.18 and 10.01 at whatever temperature the site is at
+    LUTRecalibrator<InterpolableLUT> recalibrator(lutPh, 0.01, 0.005 * 0.005, 1e-8);
+    std::mt19937_64 rng(7);
+    std::normal_distribution<double> noise(0, 0.005);
+    std::uniform_real_distribution<double> temperature(0, 55);
+    const double buffers[4] = { 4.01, 6.86, 9.18, 10.01 };
+    printf("readings   mean |error| from 4.01 to 10.01 pH\n");
+    printf("%8d   %.4f\n", 0, mean_error(recalibrator));
+    int readings = 0;
+    double observe_ns = 0;
+    double publish_us = 0;
+    int publishes = 0;
+    for (int checkpoint : { 100, 400, 1600, 6400 }) {
+        for (; readings < checkpoint; readings++) {
+            double standard = buffers[readings % 4];
+            double y = temperature(rng);
+            double raw = recalibration_forward(drifted, ph_table.ph_values_at_25, ph_table.temp_points, standard, y) + noise(rng);
+            auto start = std::chrono::steady_clock::now();
+            recalibrator.observe(standard, y, raw);
+            observe_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (readings % 50 == 49) {
+                start = std::chrono::steady_clock::now();
+                recalibrator.publish();
+                publish_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                publishes++;
+            }
+        }
+        printf("%8d   %.4f   (version %llu)\n", readings, mean_error(recalibrator), (unsigned long long)recalibrator.getVersion());
+    }
+    printf("example  observe %.0f ns, publish every 50 readings %.1f us\n", observe_ns / readings, publish_us / publishes);
+
+    // Dense table: publishing copies changed cells into a reused copy, not the whole table
+    const int x_len = 1079;
+    const int y_len = 551;
+    const SyntheticTable synthetic = synthetic_ph_table(x_len, y_len);
+    InterpolableLUT dense(synthetic.table, synthetic.x_ref, synthetic.y_ref, x_len, y_len);
+    LUTRecalibrator<InterpolableLUT> dense_recalibrator(dense, 0.01, 0.005 * 0.005);
+    auto start = std::chrono::steady_clock::now();
+    InterpolableLUT copy(dense);
+    double copy_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    // Readers check that versions never go backwards while a writer observes and publishes
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> lookups(0);
+    std::atomic<int> regressions(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++) {
+        readers.emplace_back([&, r]() {
+            uint64_t seen = 0;
+            uint64_t count = 0;
+            double sink = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                sink += dense_recalibrator.read([&](InterpolableLUT &lut) {
+                    uint64_t version = lut.getVersion();
+                    regressions += (version < seen);
+                    seen = version;
+                    return lut.find(2 + 0.001 * (count % 9000), 0.05 * (count % 1000));
+                });
+                count++;
+            }
+            lookups += count + (sink == 12345.678);
+        });
+    }
+    publish_us = 0;
+    publishes = 0;
+    auto run_start = std::chrono::steady_clock::now();
+    for (int reading = 0; reading < 20000; reading++) {
+        double standard = 2 + 0.0005 * (reading % 16000);
+        double y = 0.0025 * (reading % 20000);
+        dense_recalibrator.observe(standard, y, recalibration_forward(synthetic.table, synthetic.x_ref, synthetic.y_ref, standard, y) + 0.02);
+        if (reading % 50 == 49) {
+            start = std::chrono::steady_clock::now();
+            dense_recalibrator.publish();
+            publish_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            publishes++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+    stop = true;
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+    printf("dense    publish every 50 readings %.1f us (full table copy %.0f us), %d versions,"
+           " readers %.2f M lookups/s, version regressions %d (%u hardware threads)\n",
+           publish_us / publishes, copy_us, publishes, lookups.load() / seconds / 1e6, regressions.load(),
+           std::thread::hardware_concurrency());
+}
+
+/******************************************************************************
+                Series result cache for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Dashboard refreshes through SeriesResultCache against recomputing every range, while
+ *      samples arrive and one of two tables gets a new version
+*/
+void benchmark_series_cache() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT probe_a(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    InterpolableLUT probe_b(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    // One sample a second, two series, a day of history
+    SeriesResultCache cache;
+    const int history = 86400;
+    const int per_tick = 60;
+    long long second = 0;
+    std::vector<double> raw[3], temperatures;
+    auto append = [&](int count) {
+        for (int i = 0; i < count; i++, second++) {
+            temperatures.push_back(25 + 10 * std::sin(second * 7.27e-5));
+            raw[1].push_back(7 + 2 * std::sin(second * 1e-3));
+            raw[2].push_back(5 + std::sin(second * 3e-4));
+            cache.append(1, (double)second, raw[1].back(), temperatures.back());
+            cache.append(2, (double)second, raw[2].back(), temperatures.back());
+        }
+    };
+    append(history);
+
+    // Each dashboard shows the last 1, 6 and 24 hours of both series on both tables
+    auto refresh = [&](bool cached) {
+        double sink = 0;
+        for (uint64_t series = 1; series <= 2; series++) {
+            for (InterpolableLUT *lut : { &probe_a, &probe_b }) {
+                for (double hours : { 1.0, 6.0, 24.0 }) {
+                    double t_from = history - 3600 * hours;
+                    std::vector<double> results;
+                    if (cached) {
+                        results = cache.compensated(series, t_from, 1e12, *lut);
+                    } else {
+                        // What the dashboards did before: the whole range again
+                        size_t begin = (size_t)t_from;
+                        results.resize(second - begin);
+                        lut->find_batch(&raw[series][begin], &temperatures[begin], results.data(), results.size());
+                    }
+                    sink += results.empty() ? 0 : results.back();
+                }
+            }
+        }
+        return sink;
+    };
+
+    double times[2] = { 0, 0 };
+    double sums[2] = { 0, 0 };
+    const int ticks = 40;
+    for (int tick = 0; tick < ticks; tick++) {
+        append(per_tick);
+        if (tick == ticks / 2) {
+            // A recalibration of probe_a moves one cell, which must not cost probe_b its entries
+            CellValue cell = { 5, 3, 7.01 };
+            probe_a.setCells(&cell, 1);
+        }
+        for (int pass = 0; pass < 2; pass++) {
+            auto start = std::chrono::steady_clock::now();
+            sums[pass] += refresh(pass == 0);
+            times[pass] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    SeriesCacheStats stats = cache.getStats();
+    printf("refresh of 12 ranges: cached %.2f ms, recomputed %.2f ms (results agree: %s)\n",
+           times[0] / ticks, times[1] / ticks, (sums[0] == sums[1]) ? "yes" : "NO");
+    printf("hits %llu, tails %llu, misses %llu, invalidations %llu, %llu samples computed, %zu results held\n",
+           (unsigned long long)stats.hits, (unsigned long long)stats.tails, (unsigned long long)stats.misses,
+           (unsigned long long)stats.invalidations, (unsigned long long)stats.computed, cache.size());
+}
+
+/******************************************************************************
+                Row cache for the InterpolateLLUT class
+*******************************************************************************/
+template <typename LUT>
+void measure_row_cache(const char *name, LUT &lut) {
+    std::vector<double> x_ref = lut.getXRef();
+    std::vector<double> y_ref = lut.getYRef();
+    const int lookups = 400000;
+    std::vector<double> xs(lookups), ys(lookups);
+
+    for (int run : { 1, 8, 64 }) {
+        // Two probes read in turn, each with its own temperature, which changes every run readings
+        for (long long i = 0; i < lookups; i++) {
+            long long probe = i % 2;
+            long long reading = (i / 2) / run;
+            double u = spread_fraction(i);
+            double v = spread_fraction(reading * 2 + probe, 1);
+            xs[i] = x_ref.front() + (0.15 + 0.7 * u) * (x_ref.back() - x_ref.front());
+            ys[i] = y_ref.front() + v * (y_ref.back() - y_ref.front());
+        }
+
+        std::vector<double> results[2];
+        double ns[2];
+        for (int pass = 0; pass < 2; pass++) {
+            lut.setRowCache(pass ? 4 : 0);
+            results[pass].resize(lookups);
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < lookups; i++) {
+                results[pass][i] = lut.find(xs[i], ys[i]);
+            }
+            ns[pass] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+        }
+        // Hit rate from a second run with metrics attached, which would otherwise be in the timing
+        LUTMetrics metrics;
+        lut.attachMetrics(&metrics);
+        for (int i = 0; i < lookups; i++) {
+            lut.find(xs[i], ys[i]);
+        }
+        lut.attachMetrics(nullptr);
+        lut.setRowCache(0);
+
+        bool same = true;
+        for (int i = 0; i < lookups; i++) {
+            same = same && (results[0][i] == results[1][i]);
+        }
+        printf("%-8s %4zu x %-4zu run %2d | uncached %7.1f ns | 4 cached rows %7.1f ns (%4.1fx) | hit rate %5.1f%% | same results: %s\n",
+               name, x_ref.size(), y_ref.size(), run, ns[0], ns[1], ns[0] / ns[1],
+               100.0 * metrics.cacheHits() / (metrics.cacheHits() + metrics.cacheMisses()), same ? "yes" : "NO");
+    }
+}
+
+/**
+ * @brief Scalar find() calls in runs at one temperature, without and with the row cache
+*/
+void benchmark_row_cache() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    measure_row_cache("example", lutPh);
+
+    const SyntheticTable synthetic = synthetic_ph_table(1079, 551);
+    InterpolableLUT dense(synthetic.table, synthetic.x_ref, synthetic.y_ref, 1079, 551);
+    measure_row_cache("dense", dense);
+    InterpolableLUTf dense_float(synthetic.table, synthetic.x_ref, synthetic.y_ref, 1079, 551);
+    measure_row_cache("float", dense_float);
+}
+
+/******************************************************************************
+                Transposed roles for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Building the role-swapped table by hand through nested rows, by a plain flat transpose,
+ *      and by transposed(), and checking that they agree
+*/
+void measure_transpose(int x_len, int y_len) {
+    const SyntheticTable synthetic = synthetic_ph_table(x_len, y_len);
+    const std::vector<double> &x_ref = synthetic.x_ref;
+    const std::vector<double> &y_ref = synthetic.y_ref;
+    const std::vector<std::vector<double>> &table = synthetic.table;
+    InterpolableLUT lut(table, x_ref, y_ref, x_len, y_len);
+
+    // What consumers do today
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<double>> swapped(x_len, std::vector<double>(y_len));
+    for (int row = 0; row < y_len; row++) {
+        for (int i = 0; i < x_len; i++) {
+            swapped[i][row] = table[row][i];
+        }
+    }
+    InterpolableLUT by_hand(swapped, y_ref, x_ref, y_len, x_len);
+    double hand_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    swapped.clear();
+
+    // The flat transpose alone, element by element and in tiles
+    std::vector<double> flat((size_t)x_len * y_len), out((size_t)x_len * y_len);
+    for (int row = 0; row < y_len; row++) {
+        std::copy(table[row].begin(), table[row].end(), flat.begin() + (size_t)row * x_len);
+    }
+    start = std::chrono::steady_clock::now();
+    for (size_t row = 0; row < (size_t)y_len; row++) {
+        for (size_t i = 0; i < (size_t)x_len; i++) {
+            out[i * y_len + row] = flat[row * x_len + i];
+        }
+    }
+    double plain_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    lut_transpose(flat.data(), (size_t)y_len, (size_t)x_len, out.data());
+    double tiled_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    flat.clear();
+    flat.shrink_to_fit();
+    out.clear();
+    out.shrink_to_fit();
+
+    start = std::chrono::steady_clock::now();
+    InterpolableLUT swapped_lut = lut.transposed();
+    double transposed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Temperature at which each buffer reads a given value, both ways, and back again
+    InterpolableLUT round_trip = swapped_lut.transposed();
+    int differences = 0;
+    for (long long q = 0; q < 100000; q++) {
+        double u = spread_fraction(q);
+        double v = spread_fraction(q, 1);
+        double x = x_ref.front() + u * (x_ref.back() - x_ref.front());
+        double y = y_ref.front() + v * (y_ref.back() - y_ref.front());
+        differences += (swapped_lut.find(x, x) != by_hand.find(x, x)) + (round_trip.find(x, y) != lut.find(x, y));
+    }
+    printf("%5d x %-5d | by hand %8.1f ms | flat transpose %7.1f ms, tiled %6.1f ms | transposed() %8.1f ms | differences %d\n",
+           x_len, y_len, hand_ms, plain_ms, tiled_ms, transposed_ms, differences);
+}
+
+void benchmark_transpose() {
+    const ExamplePhTable ph_table = example_ph_table();
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    InterpolableLUT lutTemp = lutPh.transposed();
+    printf("The pH 9.18 buffer reads 9.10 at %.1f degrees\n", lutTemp.find(9.10, 9.18));
+
+    measure_transpose(1079, 551);
+    measure_transpose(4096, 4096);
+    measure_transpose(8192, 6000);
+}
+
+/******************************************************************************
+                Table validation for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Cost of the checks made while a table is loaded, against streaming the same values
+*/
+void measure_validation(int x_len, int y_len) {
+    const SyntheticTable synthetic = synthetic_ph_table(x_len, y_len);
+    const std::vector<double> &x_ref = synthetic.x_ref;
+    const std::vector<double> &y_ref = synthetic.y_ref;
+    const std::vector<std::vector<double>> &table = synthetic.table;
+    std::vector<double> flat((size_t)x_len * y_len);
+    for (int row = 0; row < y_len; row++) {
+        std::copy(table[row].begin(), table[row].end(), flat.begin() + (size_t)row * x_len);
+    }
+    double gigabytes = flat.size() * sizeof(double) / 1e9;
+
+    auto start = std::chrono::steady_clock::now();
+    double sum = 0;
+    for (double value : flat) {
+        sum += value;
+    }
+    double sum_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    bool finite = true;
+    int unsorted = 0;
+    for (int row = 0; row < y_len; row++) {
+        const double *values = &flat[(size_t)row * x_len];
+        for (int i = 0; i < x_len; i++) {
+            finite &= std::isfinite(values[i]);
+        }
+        unsorted += (detect_sort_order(values, x_len) == SortOrder::Unsorted);
+    }
+    double scalar_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    bool checked_finite = true;
+    int checked_unsorted = 0;
+    for (int row = 0; row < y_len; row++) {
+        LUTRowCheck check = lut_check_row(&flat[(size_t)row * x_len], x_len);
+        checked_finite &= check.finite;
+        checked_unsorted += (check.order == SortOrder::Unsorted);
+    }
+    double check_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    flat.clear();
+    flat.shrink_to_fit();
+
+    start = std::chrono::steady_clock::now();
+    InterpolableLUT lut(table, x_ref, y_ref, x_len, y_len);
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%5d x %-5d | sum %6.1f ms (%4.1f GB/s) | scalar checks %6.1f ms | lut_check_row %6.1f ms (%4.1f GB/s) | load %7.1f ms"
+           " | agree: %s (%g)\n",
+           x_len, y_len, sum_ms, gigabytes / sum_ms * 1e3, scalar_ms, check_ms, gigabytes / check_ms * 1e3, load_ms,
+           (finite == checked_finite && unsorted == checked_unsorted) ? "yes" : "NO", sum);
+}
+
+/**
+ * @brief Which inputs the constructor turns down, and how the checks pick the batch kernel
+*/
+void benchmark_validation() {
+    ExamplePhTable ph_table = example_ph_table();
+    auto attempt = [&](const char *what, const std::vector<std::vector<double>> &table, const std::vector<double> &x_ref,
+                       const std::vector<double> &y_ref, int x_len, int y_len) {
+        try {
+            InterpolableLUT lut(table, x_ref, y_ref, x_len, y_len);
+            printf("%-22s accepted, batch kernel %s\n", what, lut.batchKernel() == BatchKernel::Gather ? "Gather" : "Scalar");
+        } catch (const std::invalid_argument &e) {
+            printf("%-22s rejected: %s\n", what, e.what());
+        }
+    };
+    attempt("example", ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    attempt("x_len too large", ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points,
+            NUM_PH_POINTS + 1, NUM_TEMP_POINTS);
+    std::vector<double> short_temps(ph_table.temp_points.begin(), ph_table.temp_points.end() - 1);
+    attempt("short y_ref", ph_table.ph_values, ph_table.ph_values_at_25, short_temps, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    std::vector<double> bad_refs = ph_table.ph_values_at_25;
+    bad_refs[2] = std::numeric_limits<double>::infinity();
+    attempt("infinite x_ref", ph_table.ph_values, bad_refs, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    ph_table.ph_values[4][3] = std::nan("");
+    attempt("NaN in the table", ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    ph_table.ph_values[4][3] = 9.5;
+    attempt("unsorted row", ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+
+    measure_validation(1079, 551);
+    measure_validation(8192, 6000);
+}
+
+/******************************************************************************
+                Pinned pipeline for the InterpolateLLUT class
+*******************************************************************************/
+/**
+ * @brief Streams blocks of a simulated probe through a LUTPipeline, with the stages left to the
+ *      scheduler and then pinned
+*/
+template <typename LUT>
+void measure_pipeline(const char *name, LUT &lut, size_t block_count) {
+    std::vector<double> x_ref = lut.getXRef();
+    std::vector<double> y_ref = lut.getYRef();
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int pass = 0; pass < 2; pass++) {
+        PipelineConfig config;
+        if (pass == 1) {
+            // One core per stage where there are enough, otherwise every stage on the last core
+            config.acquire_cpu = (int)(cpus >= 3 ? cpus - 3 : cpus - 1);
+            config.compensate_cpu = (int)(cpus >= 3 ? cpus - 2 : cpus - 1);
+            config.publish_cpu = (int)(cpus - 1);
+        }
+        LUTPipeline<LUT> pipeline(lut, config);
+
+        size_t produced = 0;
+        uint64_t state = 12345;
+        double checksum = 0;
+        PipelineStats stats = pipeline.run(
+            [&](double *x_input, double *y_input, size_t capacity) {
+                if (produced == block_count) {
+                    return (size_t)0;
+                }
+                produced++;
+                for (size_t i = 0; i < capacity; i++) {
+                    state = state * 6364136223846793005ull + 1442695040888963407ull;
+                    double u = (double)(state >> 11) / 9007199254740992.0;
+                    x_input[i] = x_ref.front() + (0.15 + 0.7 * u) * (x_ref.back() - x_ref.front());
+                    y_input[i] = y_ref.front() + (0.5 + 0.4 * std::sin(1e-4 * (double)(produced * capacity + i))) * (y_ref.back() - y_ref.front());
+                }
+                return capacity;
+            },
+            [&](const double *, const double *, const double *out, size_t len) {
+                for (size_t i = 0; i < len; i++) {
+                    checksum += out[i];
+                }
+            });
+        printf("%-8s %-8s | %6.2f M samples/s | block latency p50 %7.1f us  p99 %7.1f us  max %8.1f us"
+               " | find_batch p50 %6.1f us  p99 %7.1f us | checksum %.6g\n",
+               name, pass ? (stats.pinned ? "pinned" : "pin n/a") : "floating", stats.samples / stats.seconds / 1e6,
+               stats.latency_p50_us, stats.latency_p99_us, stats.latency_max_us, stats.compensate_p50_us,
+               stats.compensate_p99_us, checksum);
+    }
+}
+
+void benchmark_pipeline() {
+    const ExamplePhTable ph_table = example_ph_table();
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    InterpolableLUT lutPh(ph_table.ph_values, ph_table.ph_values_at_25, ph_table.temp_points, NUM_PH_POINTS, NUM_TEMP_POINTS);
+    measure_pipeline("example", lutPh, 2000);
+
+    const SyntheticTable synthetic = synthetic_ph_table(1079, 551);
+    InterpolableLUT dense(synthetic.table, synthetic.x_ref, synthetic.y_ref, 1079, 551);
+    measure_pipeline("dense", dense, 1000);
+}
@@ -0,0 +1,107 @@
+/**
+ * @brief C interface of the Interpolable Look-up Table in InterpolableLUT.cpp, for callers
+ *      that cannot use the C++ class directly
+ *
+ * @details Tables are opaque handles created by ilut_create() or ilut_create_masked() and
+ *      released by ilut_free(). No function lets an exception escape. Every function that can
+ *      fail returns an ilut_status, and ilut_last_error() describes the most recent failure on
+ *      the calling thread.
+ *
+ *      ilut_find_batch() reads the inputs from, and writes the results to, buffers owned by
+ *      the caller, so the boundary adds no copies. A table may be searched from several
+ *      threads at once, but it must not be freed while a search is running.
+ *
+ * @author Athly
+*/
+
+#ifndef INTERPOLABLE_LUT_H
+#define INTERPOLABLE_LUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ILUT_ABI_VERSION 1
+
+typedef struct ilut_table ilut_table;
+
+typedef enum {
+    ILUT_OK = 0,
+    ILUT_ERR_NULL = -1,         /* A required pointer was NULL */
+    ILUT_ERR_SIZE = -2,         /* x_len or y_len is less than 1 */
+    ILUT_ERR_ARGUMENT = -3,     /* An argument was rejected by the table, see ilut_last_error() */
+    ILUT_ERR_MEMORY = -4,       /* Out of memory */
+    ILUT_ERR_INTERNAL = -5      /* Any other failure, see ilut_last_error() */
+} ilut_status;
+
+typedef enum {
+    ILUT_DOUBLE = 0,            /* InterpolableLUT: double storage and arithmetic */
+    ILUT_FLOAT = 1,             /* InterpolableLUTf: float storage and arithmetic */
+    ILUT_MIXED = 2              /* InterpolableLUTMixed: float storage, double arithmetic */
+} ilut_precision;
+
+typedef enum {
+    ILUT_FILL_NEAREST = 0,      /* MissingCells::FillNearest */
+    ILUT_FILL_INTERPOLATE = 1,  /* MissingCells::FillInterpolate */
+    ILUT_MASK_PER_QUERY = 2     /* MissingCells::MaskPerQuery */
+} ilut_missing_cells;
+
+/**
+ * @brief ILUT_ABI_VERSION of the library, to compare against the header a caller was built with
+*/
+int ilut_abi_version(void);
+
+/**
+ * @brief Creates a table
+ * @param table y_len rows of x_len values, row-major
+ * @param x_ref x_len interpolation reference values for the x-direction
+ * @param y_ref y_len interpolation reference values for the y-direction
+ * @param out Receives the handle, or NULL on failure
+*/
+ilut_status ilut_create(const double *table, const double *x_ref, const double *y_ref,
+                        int x_len, int y_len, ilut_precision precision, ilut_table **out);
+
+/**
+ * @brief Creates a table with missing cells
+ * @param valid y_len rows of x_len flags, row-major, 0 where the table has no measurement
+*/
+ilut_status ilut_create_masked(const double *table, const unsigned char *valid, ilut_missing_cells missing,
+                               const double *x_ref, const double *y_ref,
+                               int x_len, int y_len, ilut_precision precision, ilut_table **out);
+
+/**
+ * @brief Releases a table. NULL is ignored.
+*/
+void ilut_free(ilut_table *lut);
+
+/**
+ * @brief Standardized value for x_input at y_input, or x_input if it is out of range of the table
+*/
+ilut_status ilut_find(ilut_table *lut, double x_input, double y_input, double *out);
+
+/**
+ * @brief ilut_find() for len pairs. out may be the same buffer as x_input or y_input.
+*/
+ilut_status ilut_find_batch(ilut_table *lut, const double *x_input, const double *y_input, double *out, size_t len);
+
+ilut_status ilut_get_size(const ilut_table *lut, int *x_len, int *y_len);
+ilut_status ilut_get_table_id(const ilut_table *lut, uint64_t *table_id);
+
+/**
+ * @brief Description of an ilut_status
+*/
+const char *ilut_status_string(ilut_status status);
+
+/**
+ * @brief Message of the last failure on the calling thread, or "" if there was none
+*/
+const char *ilut_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,673 @@
+/**
+ * @brief Archive reprocessing for the Interpolable Look-up Table. It streams archived (x, y)
+ *      samples from many files through a table's batch lookup and writes the results back out.
+ *
+ * @details An archive file is a sequence of blocks of block_len samples. Each block holds its
+ *      block_len x values followed by its block_len y values, as doubles, so that a block can
+ *      be handed to ilut_find_batch() exactly as it was read. The last block of a file may be
+ *      shorter. The output file holds one double per sample, in the same order.
+ *
+ *      Reads and writes can go through:
+ *        - io_uring: up to queue_depth blocks of all files are in flight at once, read into
+ *          buffers registered with the kernel. Each block is looked up in its buffer as soon
+ *          as its read completes, and written from that same buffer. When io_uring is not
+ *          available the reader falls back to PreadThreads.
+ *        - PreadThreads: queue_depth threads, each doing blocking pread/pwrite of whole blocks
+ *        - Mmap: files are mapped and looked up in place
+ *        - Blocking: one read, lookup and write at a time
+ *
+ *      The lookup goes through the C interface in InterpolableLUT.h, so this file only
+ *      needs to be linked with InterpolableLUT.cpp.
+ *
+ * @author Athly
+*/
+
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <exception>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define LUT_HAVE_IO_URING 1
+#endif
+#endif
+
+#include "InterpolableLUT.h"
+
+enum class ArchiveIO {
+    IoUring,
+    PreadThreads,
+    Mmap,
+    Blocking
+};
+
+struct ArchiveStats {
+    ArchiveIO io;           ///< Path that did the work, PreadThreads if io_uring was asked for but unavailable
+    size_t files;
+    size_t samples;
+    double seconds;
+};
+
+/**
+ * @brief One block of one archive file
+*/
+struct ArchiveBlock {
+    int input;              ///< File descriptors
+    int output;
+    off_t input_offset;     ///< Bytes
+    off_t output_offset;
+    size_t samples;
+};
+
+#if defined(LUT_HAVE_IO_URING)
+/**
+ * @brief Minimal io_uring, set up with the raw system calls so that liburing is not needed
+*/
+class LUTUring {
+
+    public:
+        LUTUring() { }
+
+        ~LUTUring() {
+            if (sqes != nullptr) {
+                munmap(sqes, sqes_size);
+            }
+            if (cq_ptr != nullptr && cq_ptr != sq_ptr) {
+                munmap(cq_ptr, cq_size);
+            }
+            if (sq_ptr != nullptr) {
+                munmap(sq_ptr, sq_size);
+            }
+            if (ring_fd >= 0) {
+                close(ring_fd);
+            }
+        }
+
+        LUTUring(const LUTUring &) = delete;
+        LUTUring &operator=(const LUTUring &) = delete;
+
+        /**
+         * @return false if the kernel does not offer io_uring, e.g. too old or blocked by seccomp
+        */
+        bool open(unsigned entries) {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            ring_fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+            if (ring_fd < 0) {
+                return false;
+            }
+
+            sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single_mmap) {
+                sq_size = cq_size = std::max(sq_size, cq_size);
+            }
+            sq_ptr = map(sq_size, IORING_OFF_SQ_RING);
+            cq_ptr = single_mmap ? sq_ptr : map(cq_size, IORING_OFF_CQ_RING);
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = (io_uring_sqe *)map(sqes_size, IORING_OFF_SQES);
+            if (sq_ptr == nullptr || cq_ptr == nullptr || sqes == nullptr) {
+                return false;
+            }
+
+            char *sq = (char *)sq_ptr;
+            sq_head = (unsigned *)(sq + params.sq_off.head);
+            sq_tail = (unsigned *)(sq + params.sq_off.tail);
+            sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+            sq_entries = *(unsigned *)(sq + params.sq_off.ring_entries);
+            sq_array = (unsigned *)(sq + params.sq_off.array);
+            char *cq = (char *)cq_ptr;
+            cq_head = (unsigned *)(cq + params.cq_off.head);
+            cq_tail = (unsigned *)(cq + params.cq_off.tail);
+            cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+            cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+            return true;
+        }
+
+        /**
+         * @return false if the buffers could not be registered, e.g. over RLIMIT_MEMLOCK
+        */
+        bool registerBuffers(const std::vector<iovec> &buffers) {
+            return syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS,
+                           buffers.data(), (unsigned)buffers.size()) == 0;
+        }
+
+        /**
+         * @brief Queues a read or write. buffer_index is the registered buffer, or -1 for none.
+        */
+        bool queue(bool write, int fd, void *data, size_t len, off_t offset, int buffer_index, uint64_t user_data) {
+            unsigned tail = *sq_tail;
+            if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+                return false;
+            }
+            unsigned index = tail & sq_mask;
+            io_uring_sqe *sqe = &sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            if (buffer_index >= 0) {
+                sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                sqe->buf_index = (uint16_t)buffer_index;
+            } else {
+                sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+            }
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)(uintptr_t)data;
+            sqe->len = (uint32_t)len;
+            sqe->off = (uint64_t)offset;
+            sqe->user_data = user_data;
+            sq_array[index] = index;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            unsubmitted++;
+            return true;
+        }
+
+        /**
+         * @brief Submits the queued requests and waits until at least wait_for have completed
+        */
+        bool submit(unsigned wait_for) {
+            while (true) {
+                long ret = syscall(__NR_io_uring_enter, ring_fd, unsubmitted, wait_for,
+                                   wait_for > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if (ret >= 0) {
+                    unsubmitted -= (unsigned)ret;
+                    return true;
+                }
+                if (errno != EINTR) {
+                    return false;
+                }
+            }
+        }
+
+        /**
+         * @brief Takes the next completion, if there is one
+        */
+        bool complete(uint64_t *user_data, int *result) {
+            unsigned head = *cq_head;
+            if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                return false;
+            }
+            const io_uring_cqe &cqe = cqes[head & cq_mask];
+            *user_data = cqe.user_data;
+            *result = cqe.res;
+            __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+    private:
+        int ring_fd = -1;
+        void *sq_ptr = nullptr;
+        void *cq_ptr = nullptr;
+        io_uring_sqe *sqes = nullptr;
+        size_t sq_size = 0;
+        size_t cq_size = 0;
+        size_t sqes_size = 0;
+        unsigned *sq_head = nullptr;
+        unsigned *sq_tail = nullptr;
+        unsigned *sq_array = nullptr;
+        unsigned sq_mask = 0;
+        unsigned sq_entries = 0;
+        unsigned *cq_head = nullptr;
+        unsigned *cq_tail = nullptr;
+        unsigned cq_mask = 0;
+        io_uring_cqe *cqes = nullptr;
+        unsigned unsubmitted = 0;
+
+        void *map(size_t size, off_t offset) {
+            void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+            return (ptr == MAP_FAILED) ? nullptr : ptr;
+        }
+};
+#endif
+
+class ArchiveCompensator {
+
+    public:
+        /**
+         * @param lut Table used for every sample, which must outlive the compensator
+         * @param block_len Samples per archive block
+         * @param queue_depth Blocks in flight for IoUring, threads for PreadThreads
+        */
+        ArchiveCompensator(ilut_table *lut, size_t block_len = 8192, size_t queue_depth = 32)
+            :lut(lut), block_len(block_len), queue_depth(std::max<size_t>(1, queue_depth)) {
+            if (lut == nullptr || block_len == 0) {
+                throw std::invalid_argument("Need a table and a block length of at least 1");
+            }
+        }
+
+        /**
+         * @brief Compensates every input archive into the output file of the same index
+        */
+        ArchiveStats run(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs, ArchiveIO io) {
+            if (inputs.size() != outputs.size()) {
+                throw std::invalid_argument("Need one output file per input file");
+            }
+            auto start = std::chrono::steady_clock::now();
+            open_files(inputs, outputs);
+            ArchiveStats stats = { io, inputs.size(), 0, 0 };
+            try {
+                switch (io) {
+                    case ArchiveIO::IoUring:
+                        if (!run_io_uring()) {
+                            stats.io = ArchiveIO::PreadThreads;
+                            run_pread_threads();
+                        }
+                        break;
+                    case ArchiveIO::PreadThreads:
+                        run_pread_threads();
+                        break;
+                    case ArchiveIO::Mmap:
+                        run_mmap();
+                        break;
+                    case ArchiveIO::Blocking:
+                        run_blocking();
+                        break;
+                }
+            } catch (...) {
+                close_files();
+                throw;
+            }
+            for (const ArchiveBlock &block : blocks) {
+                stats.samples += block.samples;
+            }
+            close_files();
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return stats;
+        }
+
+    private:
+        ilut_table *lut;
+        size_t block_len;
+        size_t queue_depth;
+        std::vector<int> input_fds;
+        std::vector<int> output_fds;
+        std::vector<size_t> sample_counts;  ///< Per file
+        std::vector<ArchiveBlock> blocks;   ///< Every block of every file, file by file
+
+        void open_files(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs) {
+            blocks.clear();
+            for (size_t f = 0; f < inputs.size(); f++) {
+                int input = ::open(inputs[f].c_str(), O_RDONLY);
+                if (input < 0) {
+                    close_files();
+                    throw std::runtime_error("Cannot open archive " + inputs[f]);
+                }
+                input_fds.push_back(input);
+                int output = ::open(outputs[f].c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if (output < 0) {
+                    close_files();
+                    throw std::runtime_error("Cannot create " + outputs[f]);
+                }
+                output_fds.push_back(output);
+
+                struct stat info;
+                if (fstat(input, &info) != 0) {
+                    close_files();
+                    throw std::runtime_error("Cannot read the size of archive " + inputs[f]);
+                }
+                size_t samples = (size_t)info.st_size / (2 * sizeof(double));
+                sample_counts.push_back(samples);
+                for (size_t first = 0; first < samples; first += block_len) {
+                    blocks.push_back({ input, output, (off_t)(first * 2 * sizeof(double)), (off_t)(first * sizeof(double)),
+                                       std::min(block_len, samples - first) });
+                }
+            }
+        }
+
+        void close_files() {
+            for (int fd : input_fds) {
+                close(fd);
+            }
+            for (int fd : output_fds) {
+                close(fd);
+            }
+            input_fds.clear();
+            output_fds.clear();
+            sample_counts.clear();
+        }
+
+        /**
+         * @brief Looks up a block in place: buffer holds its x values then its y values, results go to out
+        */
+        void compensate(const ArchiveBlock &block, const double *buffer, double *out) {
+            ilut_status status = ilut_find_batch(lut, buffer, buffer + block.samples, out, block.samples);
+            if (status != ILUT_OK) {
+                throw std::runtime_error(std::string("ilut_find_batch: ") + ilut_last_error());
+            }
+        }
+
+        static void read_fully(int fd, void *data, size_t len, off_t offset) {
+            char *bytes = (char *)data;
+            while (len > 0) {
+                ssize_t got = pread(fd, bytes, len, offset);
+                if (got <= 0) {
+                    if (got < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    throw std::runtime_error("Archive read failed");
+                }
+                bytes += got;
+                len -= (size_t)got;
+                offset += got;
+            }
+        }
+
+        static void write_fully(int fd, const void *data, size_t len, off_t offset) {
+            const char *bytes = (const char *)data;
+            while (len > 0) {
+                ssize_t put = pwrite(fd, bytes, len, offset);
+                if (put <= 0) {
+                    if (put < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    throw std::runtime_error("Archive write failed");
+                }
+                bytes += put;
+                len -= (size_t)put;
+                offset += put;
+            }
+        }
+
+        void run_blocking() {
+            std::vector<double> buffer(3 * block_len);
+            for (const ArchiveBlock &block : blocks) {
+                read_fully(block.input, buffer.data(), 2 * block.samples * sizeof(double), block.input_offset);
+                compensate(block, buffer.data(), buffer.data() + 2 * block_len);
+                write_fully(block.output, buffer.data() + 2 * block_len, block.samples * sizeof(double), block.output_offset);
+            }
+        }
+
+        void run_pread_threads() {
+            std::atomic<size_t> next(0);
+            std::atomic<bool> failed(false);
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < std::min(queue_depth, blocks.size()); t++) {
+                workers.emplace_back([&]() {
+                    std::vector<double> buffer(3 * block_len);
+                    try {
+                        for (size_t b = next++; b < blocks.size() && !failed; b = next++) {
+                            const ArchiveBlock &block = blocks[b];
+                            read_fully(block.input, buffer.data(), 2 * block.samples * sizeof(double), block.input_offset);
+                            compensate(block, buffer.data(), buffer.data() + 2 * block_len);
+                            write_fully(block.output, buffer.data() + 2 * block_len, block.samples * sizeof(double), block.output_offset);
+                        }
+                    } catch (...) {
+                        failed = true;
+                    }
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            if (failed) {
+                throw std::runtime_error("Archive read or write failed");
+            }
+        }
+
+        void run_mmap() {
+            for (size_t f = 0; f < input_fds.size(); f++) {
+                size_t samples = sample_counts[f];
+                if (samples == 0) {
+                    continue;
+                }
+                size_t in_bytes = samples * 2 * sizeof(double);
+                size_t out_bytes = samples * sizeof(double);
+                if (ftruncate(output_fds[f], (off_t)out_bytes) != 0) {
+                    throw std::runtime_error("Cannot size output file");
+                }
+                void *in = mmap(nullptr, in_bytes, PROT_READ, MAP_SHARED, input_fds[f], 0);
+                void *out = mmap(nullptr, out_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, output_fds[f], 0);
+                if (in == MAP_FAILED || out == MAP_FAILED) {
+                    if (in != MAP_FAILED) {
+                        munmap(in, in_bytes);
+                    }
+                    if (out != MAP_FAILED) {
+                        munmap(out, out_bytes);
+                    }
+                    throw std::runtime_error("Cannot map archive");
+                }
+                madvise(in, in_bytes, MADV_SEQUENTIAL);
+                for (size_t first = 0; first < samples; first += block_len) {
+                    ArchiveBlock block = { input_fds[f], output_fds[f], 0, 0, std::min(block_len, samples - first) };
+                    compensate(block, (const double *)in + 2 * first, (double *)out + first);
+                }
+                munmap(in, in_bytes);
+                munmap(out, out_bytes);
+            }
+        }
+
+#if defined(LUT_HAVE_IO_URING)
+        /**
+         * @brief Keeps up to queue_depth blocks in flight, each in its own buffer slot
+         * @details A slot goes read -> lookup -> write -> free. Completions carry the slot in
+         *      user_data, with the low bit telling reads from writes. Short transfers are
+         *      resubmitted for the remaining bytes. After a failure no new transfers are
+         *      queued, and the ones in flight are waited for before this throws, so the kernel
+         *      never writes into buffers that were already freed.
+         * @return false if io_uring could not be set up or the kernel rejects its reads and
+         *      writes with EINVAL, as kernels older than 5.6 do for IORING_OP_READ/WRITE. The
+         *      caller then redoes every block with PreadThreads.
+        */
+        bool run_io_uring() {
+            size_t slots = std::min(queue_depth, std::max<size_t>(1, blocks.size()));
+            struct Slot {
+                size_t block;
+                size_t done;        ///< Bytes transferred so far
+                bool writing;
+            };
+            // Declared before the ring so that they outlive it, even if the ring is torn down with requests in flight
+            std::vector<double> memory(slots * 3 * block_len);
+            std::vector<Slot> state(slots);
+            std::vector<iovec> buffers(slots);
+            for (size_t s = 0; s < slots; s++) {
+                buffers[s] = { &memory[s * 3 * block_len], 3 * block_len * sizeof(double) };
+            }
+
+            LUTUring ring;
+            if (!ring.open((unsigned)slots)) {
+                return false;
+            }
+            bool registered = ring.registerBuffers(buffers);
+
+            auto queue_transfer = [&](size_t s) {
+                const ArchiveBlock &block = blocks[state[s].block];
+                char *base = (char *)buffers[s].iov_base;
+                size_t total = (state[s].writing ? 1 : 2) * block.samples * sizeof(double);
+                char *data = (state[s].writing ? (char *)((double *)base + 2 * block_len) : base) + state[s].done;
+                off_t offset = (state[s].writing ? block.output_offset : block.input_offset) + (off_t)state[s].done;
+                ring.queue(state[s].writing, state[s].writing ? block.output : block.input, data, total - state[s].done,
+                           offset, registered ? (int)s : -1, (uint64_t)s * 2 + state[s].writing);
+            };
+
+            size_t next_block = 0;
+            size_t in_flight = 0;
+            for (size_t s = 0; s < slots && next_block < blocks.size(); s++) {
+                state[s] = { next_block++, 0, false };
+                queue_transfer(s);
+                in_flight++;
+            }
+            bool unsupported = false;
+            std::exception_ptr failure;
+            while (in_flight > 0) {
+                if (!ring.submit(1)) {
+                    throw std::runtime_error("io_uring_enter failed");
+                }
+                uint64_t user_data;
+                int result;
+                while (ring.complete(&user_data, &result)) {
+                    size_t s = (size_t)(user_data / 2);
+                    Slot &slot = state[s];
+                    const ArchiveBlock &block = blocks[slot.block];
+                    if (result == -EINVAL) {
+                        unsupported = true;
+                    } else if (result <= 0 && !failure) {
+                        failure = std::make_exception_ptr(std::runtime_error(slot.writing ? "Archive write failed" : "Archive read failed"));
+                    }
+                    if (unsupported || failure) {
+                        in_flight--;
+                        continue;
+                    }
+                    slot.done += (size_t)result;
+                    size_t total = (slot.writing ? 1 : 2) * block.samples * sizeof(double);
+                    if (slot.done < total) {
+                        queue_transfer(s);
+                    } else if (!slot.writing) {
+                        double *base = (double *)buffers[s].iov_base;
+                        try {
+                            compensate(block, base, base + 2 * block_len);
+                        } catch (...) {
+                            failure = std::current_exception();
+                            in_flight--;
+                            continue;
+                        }
+                        slot.writing = true;
+                        slot.done = 0;
+                        queue_transfer(s);
+                    } else if (next_block < blocks.size()) {
+                        slot = { next_block++, 0, false };
+                        queue_transfer(s);
+                    } else {
+                        in_flight--;
+                    }
+                }
+            }
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+            return !unsupported;
+        }
+#else
+        bool run_io_uring() {
+            return false;
+        }
+#endif
+};
+
+/******************************************************************************
+                Example for the ArchiveCompensator class
+*******************************************************************************/
+/**
+ * @brief Writes an archive file of samples in the block format
+*/
+static void write_archive(const std::string &path, size_t samples, size_t block_len, unsigned seed) {
+    std::vector<double> block(2 * block_len);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Cannot create " + path);
+    }
+    for (size_t first = 0; first < samples; first += block_len) {
+        size_t count = std::min(block_len, samples - first);
+        for (size_t i = 0; i < count; i++) {
+            unsigned long long n = (first + i) * 2654435761ull + seed;
+            block[i] = 2.0 + (double)(n % 10007) / 10007 * 10.0;                // pH
+            block[count + i] = (double)((n / 10007) % 10009) / 10009 * 55.0;    // Temperature
+        }
+        fwrite(block.data(), sizeof(double), 2 * count, file);
+    }
+    fflush(file);
+    fsync(fileno(file));
+    fclose(file);
+}
+
+static ilut_table *make_ph_table() {
+    const double temp_points[12] = {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55};
+    const double ph_values_at_25[7] = {1.68, 4.01, 6.86, 7.00, 9.18, 10.01, 12.46};
+    const double ph_values[12 * 7] = {
+        1.67, 4.01, 6.98, 7.12, 9.46, 10.32, 13.47,
+        1.67, 4.01, 6.95, 7.09, 9.39, 10.25, 13.25,
+        1.67, 4.00, 6.92, 7.06, 9.32, 10.18, 13.03,
+        1.67, 4.00, 6.90, 7.04, 9.27, 10.12, 12.83,
+        1.68, 4.00, 6.88, 7.02, 9.22, 10.06, 12.64,
+        1.68, 4.01, 6.86, 7.00, 9.18, 10.01, 12.46,
+        1.69, 4.01, 6.85, 6.98, 9.14,  9.97, 12.29,
+        1.69, 4.02, 6.84, 6.98, 9.10,  9.93, 12.14,
+        1.70, 4.03, 6.84, 6.97, 9.07,  9.89, 11.99,
+        1.70, 4.04, 6.83, 6.97, 9.04,  9.86, 11.86,
+        1.71, 4.06, 6.83, 6.97, 9.01,  9.83, 11.73,
+        1.72, 4.08, 6.83, 6.97, 8.99,  9.81, 11.61
+    };
+    ilut_table *lut = nullptr;
+    if (ilut_create(ph_values, ph_values_at_25, temp_points, 7, 12, ILUT_DOUBLE, &lut) != ILUT_OK) {
+        throw std::runtime_error(ilut_last_error());
+    }
+    return lut;
+}
+
+void example_archive() {
+    const size_t block_len = 4096;
+    write_archive("archive_example.bin", 10000, block_len, 1);
+    ilut_table *lut = make_ph_table();
+    ArchiveCompensator compensator(lut, block_len, 8);
+    ArchiveStats stats = compensator.run({ "archive_example.bin" }, { "archive_example.out" }, ArchiveIO::IoUring);
+    printf("%zu samples in %.2f ms%s\n", stats.samples, stats.seconds * 1e3,
+           stats.io == ArchiveIO::IoUring ? " with io_uring" : " with pread threads");
+    ilut_free(lut);
+    remove("archive_example.bin");
+    remove("archive_example.out");
+}
+
+/**
+ * @brief Compensates the same archives through each I/O path, with the inputs evicted from the page cache first
+*/
+void benchmark_archive(const std::string &directory = ".") {
+    const size_t files = 32;
+    const size_t samples = 256 * 1024;
+    const size_t block_len = 8192;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    for (size_t f = 0; f < files; f++) {
+        inputs.push_back(directory + "/archive_" + std::to_string(f) + ".bin");
+        outputs.push_back(directory + "/archive_" + std::to_string(f) + ".out");
+        write_archive(inputs.back(), samples, block_len, (unsigned)f);
+    }
+
+    ilut_table *lut = make_ph_table();
+    ArchiveCompensator compensator(lut, block_len, 32);
+    const ArchiveIO paths[] = { ArchiveIO::Blocking, ArchiveIO::Mmap, ArchiveIO::PreadThreads, ArchiveIO::IoUring };
+    const char *names[] = { "blocking", "mmap", "pread threads", "io_uring" };
+    std::vector<double> reference;
+    for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++) {
+        ArchiveIO io = paths[p];
+        for (const std::string &input : inputs) {
+            int fd = open(input.c_str(), O_RDONLY);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+        ArchiveStats stats = compensator.run(inputs, outputs, io);
+
+        // Outputs of every path must match the first
+        std::vector<double> result(samples);
+        FILE *file = fopen(outputs.back().c_str(), "rb");
+        size_t got = fread(result.data(), sizeof(double), samples, file);
+        fclose(file);
+        if (reference.empty()) {
+            reference = result;
+        }
+        printf("%-14s %8.1f ms  %7.1f MB/s  %6.1f M samples/s%s%s\n", names[p],
+               stats.seconds * 1e3, stats.samples * 3 * sizeof(double) / stats.seconds / 1e6, stats.samples / stats.seconds / 1e6,
+               (got == samples && result == reference) ? "" : "  (output differs)",
+               (io == ArchiveIO::IoUring && stats.io != io) ? "  (fell back to pread threads)" : "");
+    }
+    ilut_free(lut);
+    for (size_t f = 0; f < files; f++) {
+        remove(inputs[f].c_str());
+        remove(outputs[f].c_str());
+    }
+}
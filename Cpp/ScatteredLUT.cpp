@@ -0,0 +1,582 @@
+/**
+ * @brief Scattered-data Look-up Table. It interpolates values measured at arbitrary (x, y)
+ *      points that do not lie on a rectilinear grid.
+ *
+ * @details The points are triangulated once (Delaunay, Bowyer-Watson) at construction. A query
+ *      locates the triangle that contains it and blends the values at its three corners with
+ *      barycentric weights, which is exact for data that is linear within each triangle.
+ *
+ *      Triangles are located with a bucket grid laid over the points. Each bucket lists the
+ *      triangles overlapping it, so a lookup only tests a handful of candidates. find_batch()
+ *      additionally starts from the triangle of the previous query and walks across
+ *      neighbouring triangles, which is cheaper than the bucket grid for time series where
+ *      consecutive samples are close together.
+ *
+ *      For pH calibration data, x and y are the measured pH and the temperature of each
+ *      buffer reading, and the value is the pH of that buffer at the standard temperature.
+ *      Like InterpolableLUT, a query outside of the data returns x_input unchanged.
+ *
+ * @author Athly
+*/
+
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+class ScatteredLUT {
+
+    public:
+        ScatteredLUT(const std::vector<double> &x_points,
+                     const std::vector<double> &y_points,
+                     const std::vector<double> &values) {
+            if (x_points.size() != y_points.size() || x_points.size() != values.size()) {
+                throw std::invalid_argument("Point and value lists must have the same length");
+            }
+            if (x_points.size() < 3) {
+                throw std::invalid_argument("At least three points are needed to triangulate");
+            }
+
+            // Delaunay triangulations are not scale invariant, so both axes are normalized to
+            // [0, 1] first. Otherwise a pH axis of 1-14 against a temperature axis of 0-100
+            // would produce long slivers across the pH direction.
+            x_min = *std::min_element(x_points.begin(), x_points.end());
+            y_min = *std::min_element(y_points.begin(), y_points.end());
+            double x_span = *std::max_element(x_points.begin(), x_points.end()) - x_min;
+            double y_span = *std::max_element(y_points.begin(), y_points.end()) - y_min;
+            x_scale = (x_span > 0) ? 1.0 / x_span : 1.0;
+            y_scale = (y_span > 0) ? 1.0 / y_span : 1.0;
+
+            for (size_t i = 0; i < x_points.size(); i++) {
+                vertices.push_back({ (x_points[i] - x_min) * x_scale, (y_points[i] - y_min) * y_scale, values[i] });
+            }
+            remove_duplicate_vertices();
+            triangulate();
+            build_coefficients();
+            build_buckets();
+        }
+
+        ~ScatteredLUT() { }
+
+        /**
+         * @brief Interpolates the value at (x_input, y_input)
+         * @return The interpolated value, or x_input if the point is outside of the data or not finite
+        */
+        double find(double x_input, double y_input) const {
+            if (!std::isfinite(x_input) || !std::isfinite(y_input)) {
+                return x_input;
+            }
+            double px = (x_input - x_min) * x_scale;
+            double py = (y_input - y_min) * y_scale;
+            int tri = locate_bucket(px, py);
+            return (tri >= 0) ? interpolate(tri, px, py) : x_input;
+        }
+
+        /**
+         * @brief Interpolates len points, writing the results to out
+         * @details Each query first tries the triangle of the previous query and walks from it
+         *      before falling back to the bucket grid. Queries that are not finite give x_input,
+         *      like find(), and do not move the starting triangle.
+        */
+        void find_batch(const double *x_input, const double *y_input, double *out, size_t len) const {
+            int previous = -1;
+            for (size_t i = 0; i < len; i++) {
+                if (!std::isfinite(x_input[i]) || !std::isfinite(y_input[i])) {
+                    out[i] = x_input[i];
+                    continue;
+                }
+                double px = (x_input[i] - x_min) * x_scale;
+                double py = (y_input[i] - y_min) * y_scale;
+                int tri = (previous >= 0) ? locate_walk(px, py, previous) : -1;
+                if (tri < 0) {
+                    tri = locate_bucket(px, py);
+                }
+                if (tri >= 0) {
+                    out[i] = interpolate(tri, px, py);
+                    previous = tri;
+                } else {
+                    out[i] = x_input[i];
+                }
+            }
+        }
+
+        /**
+         * @brief Number of distinct points and of triangles in the triangulation
+        */
+        size_t point_count() const { return vertices.size(); }
+        size_t triangle_count() const { return triangles.size(); }
+
+        /**
+         * @brief Bytes used by the triangulation and the bucket grid
+        */
+        size_t memory_usage() const {
+            return vertices.size() * sizeof(Vertex) + triangles.size() * (sizeof(Triangle) + sizeof(Coefficients)) +
+                   bucket_offsets.size() * sizeof(int) + bucket_triangles.size() * sizeof(int);
+        }
+
+    private:
+        struct Vertex {
+            double x;
+            double y;
+            double value;
+        };
+
+        struct Triangle {
+            int v[3];   ///< Vertex indexes, counter-clockwise
+            int n[3];   ///< Neighbouring triangle across the edge opposite v[k], -1 on the hull
+        };
+
+        /**
+         * @brief Precomputed barycentric transform of a triangle
+         * @details l0 = m00 * (x - x2) + m01 * (y - y2), l1 = m10 * (x - x2) + m11 * (y - y2),
+         *      l2 = 1 - l0 - l1
+        */
+        struct Coefficients {
+            double x2, y2;
+            double m00, m01, m10, m11;
+            double v0, v1, v2;
+        };
+
+        double x_min, y_min;        ///< Offsets applied to queries before scaling
+        double x_scale, y_scale;    ///< Scales applied to queries to normalize them to [0, 1]
+        std::vector<Vertex> vertices;
+        std::vector<Triangle> triangles;
+        std::vector<Coefficients> coefficients;
+        int buckets_per_side;
+        std::vector<int> bucket_offsets;    ///< Start of each bucket in bucket_triangles, plus an end marker
+        std::vector<int> bucket_triangles;  ///< Triangles overlapping each bucket, back to back
+
+        static constexpr double inside_tolerance = 1e-12;
+
+        static double orient(const Vertex &a, const Vertex &b, double px, double py) {
+            return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+        }
+
+        /**
+         * @brief Positive when (px, py) is inside the circumcircle of the counter-clockwise a, b, c
+        */
+        static double in_circle(const Vertex &a, const Vertex &b, const Vertex &c, double px, double py) {
+            double adx = a.x - px, ady = a.y - py;
+            double bdx = b.x - px, bdy = b.y - py;
+            double cdx = c.x - px, cdy = c.y - py;
+            double ad = adx * adx + ady * ady;
+            double bd = bdx * bdx + bdy * bdy;
+            double cd = cdx * cdx + cdy * cdy;
+            return adx * (bdy * cd - bd * cdy) - ady * (bdx * cd - bd * cdx) + ad * (bdx * cdy - bdy * cdx);
+        }
+
+        /**
+         * @brief Keeps one of each set of points at the same place, which must agree on the value
+        */
+        void remove_duplicate_vertices() {
+            std::sort(vertices.begin(), vertices.end(), [](const Vertex &a, const Vertex &b) {
+                return (a.x < b.x) || (a.x == b.x && a.y < b.y);
+            });
+            for (size_t i = 1; i < vertices.size(); i++) {
+                if (vertices[i].x == vertices[i - 1].x && vertices[i].y == vertices[i - 1].y &&
+                    vertices[i].value != vertices[i - 1].value) {
+                    throw std::invalid_argument("Points at the same place must have the same value");
+                }
+            }
+            vertices.erase(std::unique(vertices.begin(), vertices.end(), [](const Vertex &a, const Vertex &b) {
+                return a.x == b.x && a.y == b.y;
+            }), vertices.end());
+        }
+
+        /**
+         * @brief Bowyer-Watson insertion, walking to each new point from the last triangle created
+        */
+        void triangulate() {
+            int point_count = (int)vertices.size();
+
+            // Super triangle well outside of the unit square the points were normalized to
+            vertices.push_back({ -100.0, -100.0, 0.0 });
+            vertices.push_back({ 100.0, -100.0, 0.0 });
+            vertices.push_back({ 0.0, 100.0, 0.0 });
+            std::vector<Triangle> work = { { { point_count, point_count + 1, point_count + 2 }, { -1, -1, -1 } } };
+            std::vector<char> alive = { 1 };
+            std::vector<int> visit_mark = { -1 };
+
+            // Inserting in a spatially coherent order keeps the walks short
+            std::vector<int> order(point_count);
+            for (int i = 0; i < point_count; i++) {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [this](int a, int b) {
+                return hilbert_key(vertices[a].x, vertices[a].y) < hilbert_key(vertices[b].x, vertices[b].y);
+            });
+
+            std::vector<int> cavity, stack;
+            struct BoundaryEdge { int a, b, outside; };
+            std::vector<BoundaryEdge> boundary;
+            int last = 0;
+
+            for (int p : order) {
+                double px = vertices[p].x;
+                double py = vertices[p].y;
+
+                // Walk to the triangle containing p
+                int tri = last;
+                for (bool moved = true; moved;) {
+                    moved = false;
+                    for (int k = 0; k < 3; k++) {
+                        const Triangle &t = work[tri];
+                        if (t.n[k] >= 0 && orient(vertices[t.v[(k + 1) % 3]], vertices[t.v[(k + 2) % 3]], px, py) < 0) {
+                            tri = t.n[k];
+                            moved = true;
+                            break;
+                        }
+                    }
+                }
+
+                // Grow the cavity of triangles whose circumcircle contains p
+                cavity.clear();
+                boundary.clear();
+                stack.assign(1, tri);
+                visit_mark[tri] = p;
+                while (!stack.empty()) {
+                    int current = stack.back();
+                    stack.pop_back();
+                    cavity.push_back(current);
+                    for (int k = 0; k < 3; k++) {
+                        int neighbour = work[current].n[k];
+                        bool in_cavity = false;
+                        if (neighbour >= 0) {
+                            if (visit_mark[neighbour] == p) {
+                                continue;   // Already in the cavity, so this edge is interior
+                            }
+                            const Triangle &t = work[neighbour];
+                            in_cavity = in_circle(vertices[t.v[0]], vertices[t.v[1]], vertices[t.v[2]], px, py) > 0;
+                        }
+                        if (in_cavity) {
+                            visit_mark[neighbour] = p;
+                            stack.push_back(neighbour);
+                        } else {
+                            boundary.push_back({ work[current].v[(k + 1) % 3], work[current].v[(k + 2) % 3], neighbour });
+                        }
+                    }
+                }
+
+                // Fan the cavity boundary around p, reusing the cavity's slots first
+                std::vector<int> created(boundary.size());
+                for (size_t i = 0; i < boundary.size(); i++) {
+                    int slot;
+                    if (i < cavity.size()) {
+                        slot = cavity[i];
+                    } else {
+                        slot = (int)work.size();
+                        work.push_back(Triangle());
+                        alive.push_back(1);
+                        visit_mark.push_back(-1);
+                    }
+                    created[i] = slot;
+                    work[slot] = { { boundary[i].a, boundary[i].b, p }, { -1, -1, boundary[i].outside } };
+                }
+                for (size_t i = boundary.size(); i < cavity.size(); i++) {
+                    alive[cavity[i]] = 0;
+                    visit_mark[cavity[i]] = p;
+                }
+                for (size_t i = 0; i < boundary.size(); i++) {
+                    int outside = boundary[i].outside;
+                    if (outside >= 0) {
+                        for (int k = 0; k < 3; k++) {
+                            Triangle &t = work[outside];
+                            if (t.v[(k + 1) % 3] == boundary[i].b && t.v[(k + 2) % 3] == boundary[i].a) {
+                                t.n[k] = created[i];
+                            }
+                        }
+                    }
+                    // Edge (b, p) is shared with the fan triangle starting at b, edge (p, a) with
+                    // the one ending at a
+                    for (size_t j = 0; j < boundary.size(); j++) {
+                        if (boundary[j].a == boundary[i].b) {
+                            work[created[i]].n[0] = created[j];
+                        }
+                        if (boundary[j].b == boundary[i].a) {
+                            work[created[i]].n[1] = created[j];
+                        }
+                    }
+                }
+                last = created[0];
+            }
+
+            // Drop every triangle touching the super triangle and renumber the rest
+            std::vector<int> renumber(work.size(), -1);
+            for (size_t i = 0; i < work.size(); i++) {
+                const Triangle &t = work[i];
+                if (alive[i] && t.v[0] < point_count && t.v[1] < point_count && t.v[2] < point_count) {
+                    renumber[i] = (int)triangles.size();
+                    triangles.push_back(t);
+                }
+            }
+            for (Triangle &t : triangles) {
+                for (int k = 0; k < 3; k++) {
+                    t.n[k] = (t.n[k] >= 0) ? renumber[t.n[k]] : -1;
+                }
+            }
+            vertices.resize(point_count);
+        }
+
+        /**
+         * @brief Position of a point in [0, 1]^2 along a Hilbert curve, used as an insertion order
+        */
+        static unsigned hilbert_key(double x, double y) {
+            const unsigned side = 1u << 16;
+            unsigned hx = (unsigned)std::min(std::max(x, 0.0) * (side - 1), (double)(side - 1));
+            unsigned hy = (unsigned)std::min(std::max(y, 0.0) * (side - 1), (double)(side - 1));
+            unsigned key = 0;
+            for (unsigned s = side / 2; s > 0; s /= 2) {
+                unsigned rx = (hx & s) > 0;
+                unsigned ry = (hy & s) > 0;
+                key += s * s * ((3 * rx) ^ ry);
+                if (ry == 0) {
+                    if (rx == 1) {
+                        hx = side - 1 - hx;
+                        hy = side - 1 - hy;
+                    }
+                    std::swap(hx, hy);
+                }
+            }
+            return key;
+        }
+
+        void build_coefficients() {
+            coefficients.resize(triangles.size());
+            for (size_t i = 0; i < triangles.size(); i++) {
+                const Vertex &a = vertices[triangles[i].v[0]];
+                const Vertex &b = vertices[triangles[i].v[1]];
+                const Vertex &c = vertices[triangles[i].v[2]];
+                double det = (a.x - c.x) * (b.y - c.y) - (b.x - c.x) * (a.y - c.y);
+                coefficients[i] = { c.x, c.y,
+                                    (b.y - c.y) / det, (c.x - b.x) / det,
+                                    (c.y - a.y) / det, (a.x - c.x) / det,
+                                    a.value, b.value, c.value };
+            }
+        }
+
+        /**
+         * @brief Lists every triangle in each bucket its bounding box overlaps
+        */
+        void build_buckets() {
+            buckets_per_side = std::max(1, (int)std::sqrt((double)triangles.size() / 2.0));
+            int bucket_count = buckets_per_side * buckets_per_side;
+            std::vector<int> counts(bucket_count + 1, 0);
+
+            auto for_each_bucket = [this](int tri, auto &&visit) {
+                const Triangle &t = triangles[tri];
+                double lo_x = std::min({ vertices[t.v[0]].x, vertices[t.v[1]].x, vertices[t.v[2]].x });
+                double hi_x = std::max({ vertices[t.v[0]].x, vertices[t.v[1]].x, vertices[t.v[2]].x });
+                double lo_y = std::min({ vertices[t.v[0]].y, vertices[t.v[1]].y, vertices[t.v[2]].y });
+                double hi_y = std::max({ vertices[t.v[0]].y, vertices[t.v[1]].y, vertices[t.v[2]].y });
+                for (int by = bucket_index(lo_y); by <= bucket_index(hi_y); by++) {
+                    for (int bx = bucket_index(lo_x); bx <= bucket_index(hi_x); bx++) {
+                        visit(by * buckets_per_side + bx);
+                    }
+                }
+            };
+
+            for (int tri = 0; tri < (int)triangles.size(); tri++) {
+                for_each_bucket(tri, [&counts](int bucket) { counts[bucket + 1]++; });
+            }
+            for (int i = 0; i < bucket_count; i++) {
+                counts[i + 1] += counts[i];
+            }
+            bucket_offsets = counts;
+            bucket_triangles.resize(counts[bucket_count]);
+            for (int tri = 0; tri < (int)triangles.size(); tri++) {
+                for_each_bucket(tri, [this, &counts, tri](int bucket) { bucket_triangles[counts[bucket]++] = tri; });
+            }
+        }
+
+        int bucket_index(double coordinate) const {
+            int index = (int)(coordinate * buckets_per_side);
+            return std::min(std::max(index, 0), buckets_per_side - 1);
+        }
+
+        bool contains(int tri, double px, double py) const {
+            const Coefficients &c = coefficients[tri];
+            double l0 = c.m00 * (px - c.x2) + c.m01 * (py - c.y2);
+            double l1 = c.m10 * (px - c.x2) + c.m11 * (py - c.y2);
+            return (l0 >= -inside_tolerance) && (l1 >= -inside_tolerance) && (1.0 - l0 - l1 >= -inside_tolerance);
+        }
+
+        double interpolate(int tri, double px, double py) const {
+            const Coefficients &c = coefficients[tri];
+            double l0 = c.m00 * (px - c.x2) + c.m01 * (py - c.y2);
+            double l1 = c.m10 * (px - c.x2) + c.m11 * (py - c.y2);
+            return l0 * c.v0 + l1 * c.v1 + (1.0 - l0 - l1) * c.v2;
+        }
+
+        /**
+         * @brief Finds the triangle containing the normalized point, or -1 outside of the data
+        */
+        int locate_bucket(double px, double py) const {
+            if (!(px >= 0.0 && px <= 1.0 && py >= 0.0 && py <= 1.0)) {
+                return -1;
+            }
+            int bucket = bucket_index(py) * buckets_per_side + bucket_index(px);
+            for (int i = bucket_offsets[bucket]; i < bucket_offsets[bucket + 1]; i++) {
+                if (contains(bucket_triangles[i], px, py)) {
+                    return bucket_triangles[i];
+                }
+            }
+            return -1;
+        }
+
+        /**
+         * @brief Walks from start towards the normalized point for a few steps
+         * @return The containing triangle, or -1 if the walk left the hull or took too long
+        */
+        int locate_walk(double px, double py, int start) const {
+            const int max_steps = 8;
+            int tri = start;
+            for (int step = 0; step < max_steps; step++) {
+                int next = tri;
+                const Triangle &t = triangles[tri];
+                for (int k = 0; k < 3; k++) {
+                    if (orient(vertices[t.v[(k + 1) % 3]], vertices[t.v[(k + 2) % 3]], px, py) < -inside_tolerance) {
+                        next = t.n[k];
+                        break;
+                    }
+                }
+                if (next == tri) {
+                    return tri;
+                }
+                if (next < 0) {
+                    return -1;
+                }
+                tri = next;
+            }
+            return -1;
+        }
+};
+
+/******************************************************************************
+                Example for the ScatteredLUT class
+*******************************************************************************/
+void example_scattered() {
+    // Each buffer was measured at its own set of temperatures, so there is no common grid
+    const std::vector<double> ph_at_25 = { 4.01, 6.86, 9.18, 12.46 };
+    const std::vector<std::vector<double>> temperatures = {
+        { 0.0, 12.0, 25.0, 37.0, 50.0 },
+        { 2.0, 18.0, 25.0, 41.0, 55.0 },
+        { 5.0, 15.0, 25.0, 30.0, 45.0 },
+        { 0.0, 10.0, 25.0, 35.0, 55.0 }
+    };
+    const std::vector<std::vector<double>> measured = {
+        { 4.01, 4.00, 4.01, 4.02, 4.06 },
+        { 6.97, 6.88, 6.86, 6.84, 6.83 },
+        { 9.39, 9.29, 9.18, 9.14, 9.04 },
+        { 13.47, 13.03, 12.46, 12.14, 11.61 }
+    };
+
+    std::vector<double> x, y, values;
+    for (size_t buffer = 0; buffer < ph_at_25.size(); buffer++) {
+        for (size_t i = 0; i < temperatures[buffer].size(); i++) {
+            x.push_back(measured[buffer][i]);
+            y.push_back(temperatures[buffer][i]);
+            values.push_back(ph_at_25[buffer]);
+        }
+    }
+
+    ScatteredLUT lutPh(x, y, values);
+    printf("%zu points, %zu triangles\n", lutPh.point_count(), lutPh.triangle_count());
+    printf("pH: %.2f\n", lutPh.find(7.01, 37.0));
+    printf("pH: %.2f\n", lutPh.find(8.00, 37.0));
+    printf("pH: %.2f\n", lutPh.find(9.00, 37.0));
+    printf("pH: %.2f\n", lutPh.find(12.00, 20.0));
+}
+
+/******************************************************************************
+                Triangulation vs gridding for the ScatteredLUT class
+*******************************************************************************/
+/**
+ * @brief Compares looking up scattered points directly against the common alternative of
+ *      resampling them onto a regular grid first and using bilinear interpolation on that
+*/
+void benchmark_scattered() {
+    // Smooth pH-like surface sampled at random points
+    auto surface = [](double x, double y) { return x - 0.0035 * (y - 25.0) * (x - 7.0) + 0.05 * std::sin(x) * std::cos(y / 10.0); };
+
+    const int point_counts[] = { 100, 2000, 50000 };
+    for (int point_count : point_counts) {
+        std::vector<double> x(point_count), y(point_count), values(point_count);
+        unsigned seed = 12345;
+        auto next_random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (double)(seed >> 8) / (double)(1u << 24); };
+        for (int i = 0; i < point_count; i++) {
+            x[i] = 1.0 + 13.0 * next_random();
+            y[i] = 100.0 * next_random();
+            values[i] = surface(x[i], y[i]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        ScatteredLUT lut(x, y, values);
+        double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Gridding: resample through the triangulation at about as many nodes as there are points
+        start = std::chrono::steady_clock::now();
+        int grid_side = std::max(4, (int)std::sqrt((double)point_count));
+        std::vector<double> grid(grid_side * grid_side);
+        for (int j = 0; j < grid_side; j++) {
+            for (int i = 0; i < grid_side; i++) {
+                double gx = 1.0 + 13.0 * i / (grid_side - 1);
+                double gy = 100.0 * j / (grid_side - 1);
+                grid[j * grid_side + i] = lut.find(gx, gy);
+            }
+        }
+        double grid_seconds = build_seconds + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        auto grid_find = [&](double qx, double qy) {
+            double fx = (qx - 1.0) / 13.0 * (grid_side - 1);
+            double fy = qy / 100.0 * (grid_side - 1);
+            int i = std::min(std::max((int)fx, 0), grid_side - 2);
+            int j = std::min(std::max((int)fy, 0), grid_side - 2);
+            double tx = fx - i, ty = fy - j;
+            const double *row0 = &grid[j * grid_side + i];
+            const double *row1 = row0 + grid_side;
+            return (row0[0] + (row0[1] - row0[0]) * tx) * (1 - ty) + (row1[0] + (row1[1] - row1[0]) * tx) * ty;
+        };
+
+        // Queries well inside the hull, in a time-series-like random walk
+        const int query_count = 500000;
+        std::vector<double> qx(query_count), qy(query_count), out(query_count);
+        double wx = 7.0, wy = 50.0;
+        for (int i = 0; i < query_count; i++) {
+            wx = std::min(std::max(wx + 0.02 * (next_random() - 0.5), 3.0), 12.0);
+            wy = std::min(std::max(wy + 0.2 * (next_random() - 0.5), 10.0), 90.0);
+            qx[i] = wx;
+            qy[i] = wy;
+        }
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < query_count; i++) {
+            out[i] = lut.find(qx[i], qy[i]);
+        }
+        double scalar_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        lut.find_batch(qx.data(), qy.data(), out.data(), query_count);
+        double batch_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double triangle_error = 0;
+        for (int i = 0; i < query_count; i++) {
+            triangle_error = std::max(triangle_error, std::fabs(out[i] - surface(qx[i], qy[i])));
+        }
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < query_count; i++) {
+            out[i] = grid_find(qx[i], qy[i]);
+        }
+        double gridded_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double grid_error = 0;
+        for (int i = 0; i < query_count; i++) {
+            grid_error = std::max(grid_error, std::fabs(out[i] - surface(qx[i], qy[i])));
+        }
+
+        printf("%6d points: build %.4f s, find %.1f M/s, find_batch %.1f M/s, max error %.2e\n",
+               point_count, build_seconds, query_count / scalar_seconds / 1e6, query_count / batch_seconds / 1e6, triangle_error);
+        printf("%6s gridded %dx%d: build %.4f s, find %.1f M/s, max error %.2e\n",
+               "", grid_side, grid_side, grid_seconds, query_count / gridded_seconds / 1e6, grid_error);
+    }
+}